@@ -33,8 +33,8 @@ if not build_dir.exists():
 ninja = open(build_dir / "build.ninja", "w")
 
 deps = ["glfw3", "vulkan"]
-cxxflags = ["-std=c++17", "-Wall"]
-ldflags = []
+cxxflags = ["-std=c++17", "-Wall", "-pthread", f"-I{(src_dir / 'src').absolute()}"]
+ldflags = ["-pthread"]
 for dep in deps:
     cxxflags += pkg_config_cflags(dep)
     ldflags += pkg_config_libs(dep)
@@ -68,7 +68,18 @@ for sh in shaders:
 executable = "learn-vulkan"
 
 ninja.write(f"build {executable}: link {' '.join(objs)} | {' '.join(spvs)}\n")
-ninja.write(f"default {executable}\n")
+
+# every tools/*.cc is its own executable, linked against everything in src/ except main
+lib_objs = [obj for obj in objs if Path(obj).stem != "main"]
+executables = [executable]
+for tool in glob("tools/*.cc"):
+    tool = Path(tool)
+    obj = tool.with_suffix('.o')
+    ninja.write(f"build {obj}: cxx $srcdir/{tool}\n")
+    ninja.write(f"build {tool.stem}: link {obj} {' '.join(lib_objs)}\n")
+    executables.append(tool.stem)
+
+ninja.write(f"default {' '.join(executables)}\n")
 ninja.close()
 
 os.chdir(build_dir)
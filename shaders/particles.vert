@@ -0,0 +1,20 @@
+#version 450
+
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec4 inVelocity;
+
+// see ParticleDrawParams
+layout(push_constant) uniform Params {
+    mat4 viewProjection;
+} params;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    gl_Position = params.viewProjection * vec4(inPosition.xyz, 1.0);
+    gl_PointSize = 1.0;
+
+    // slow particles on the outside are blue, fast ones near the center orange
+    float speed = clamp(length(inVelocity.xyz), 0.0, 1.0);
+    fragColor = mix(vec3(0.1, 0.2, 0.6), vec3(1.0, 0.5, 0.1), speed) * 0.25;
+}
@@ -1,8 +1,26 @@
 #version 450
 
+// set through vk::SpecializationInfo, see FragmentSpecialization
+layout(constant_id = 0) const bool USE_TEXTURE = true;
+layout(constant_id = 1) const bool DESATURATE = false;
+
 layout(location = 0) in vec3 fragColor;
+layout(location = 2) in vec2 fragTexCoord;
 layout(location = 0) out vec4 outColor;
 
+layout(binding = 0) uniform sampler2D texSampler;
+
+// see DrawPushConstants
+layout(push_constant) uniform DrawPushConstants {
+    vec4 tint;
+} push;
+
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    outColor = vec4(fragColor, 1.0) * push.tint;
+    if (USE_TEXTURE) {
+        outColor *= texture(texSampler, fragTexCoord);
+    }
+    if (DESATURATE) {
+        outColor.rgb = vec3(dot(outColor.rgb, vec3(0.2126, 0.7152, 0.0722)));
+    }
 }
\ No newline at end of file
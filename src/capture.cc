@@ -0,0 +1,551 @@
+#include "capture.h"
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <tuple>
+
+namespace
+{
+
+const char CAPTURE_MAGIC[8] = {'L', 'V', 'C', 'A', 'P', 0, 0, 0};
+
+// bounds checked reads for parsing, frames are only handed to CaptureCursor once every op in them is validated
+struct ParseCursor
+{
+    const uint8_t *pos;
+    const uint8_t *end;
+
+    bool read(void *dst, size_t size)
+    {
+        if ((size_t)(end - pos) < size)
+        {
+            return false;
+        }
+        memcpy(dst, pos, size);
+        pos += size;
+        return true;
+    }
+
+    bool skip(size_t size)
+    {
+        if ((size_t)(end - pos) < size)
+        {
+            return false;
+        }
+        pos += size;
+        return true;
+    }
+
+    bool read_blob(std::vector<uint8_t> &blob)
+    {
+        uint64_t size;
+        if (!read(&size, sizeof(size)) || (uint64_t)(end - pos) < size)
+        {
+            return false;
+        }
+        blob.assign(pos, pos + size);
+        pos += size;
+        return true;
+    }
+};
+
+// only the states the app records, anything else would reach the replay's Vulkan calls as an invalid enum
+bool pipeline_valid(const CapturePipeline &pipeline)
+{
+    return pipeline.cull_mode <= VK_CULL_MODE_FRONT_AND_BACK && pipeline.front_face <= VK_FRONT_FACE_CLOCKWISE &&
+           pipeline.polygon_mode <= VK_POLYGON_MODE_LINE && pipeline.blend_enable <= 1 && pipeline.use_texture <= 1 &&
+           pipeline.desaturate <= 1;
+}
+
+struct BoundBuffer
+{
+    bool bound = false;
+    uint32_t id = 0;
+    uint64_t offset = 0;
+    uint32_t index_type = 0;
+};
+
+// state set so far in the frame being parsed, every frame is replayed into its own command buffer so nothing
+// carries over from the previous one
+struct FrameState
+{
+    bool in_render_pass = false;
+    bool pipeline = false;
+    bool viewport = false;
+    bool scissor = false;
+    bool descriptor_set = false;
+    bool uniforms = false;
+    bool push_constants = false;
+    BoundBuffer vertex_buffer;
+    BoundBuffer index_buffer;
+};
+
+// range of index values read by an indexed draw, keyed by buffer, offset, index type, first index and count
+using IndexRangeKey = std::tuple<uint32_t, uint64_t, uint32_t, uint32_t, uint32_t>;
+using IndexRangeCache = std::map<IndexRangeKey, std::pair<uint32_t, uint32_t>>;
+
+uint64_t index_size(uint32_t index_type)
+{
+    return index_type == VK_INDEX_TYPE_UINT16 ? 2 : 4;
+}
+
+// everything a draw consumes has to be set, the pipeline layout uses both sets and the push constant range
+bool draw_state_complete(const FrameState &state)
+{
+    return state.in_render_pass && state.pipeline && state.viewport && state.scissor && state.descriptor_set &&
+           state.uniforms && state.push_constants && state.vertex_buffer.bound;
+}
+
+uint64_t bound_vertex_count(const CaptureFile &capture, const FrameState &state)
+{
+    const CaptureBuffer &buffer = capture.buffers[state.vertex_buffer.id];
+    return (buffer.data.size() - state.vertex_buffer.offset) / sizeof(PackedVertex);
+}
+
+bool draw_valid(const CaptureDraw &draw, const CaptureFile &capture, const FrameState &state)
+{
+    return draw_state_complete(state) &&
+           (uint64_t)draw.first_vertex + draw.vertex_count <= bound_vertex_count(capture, state);
+}
+
+// without robustBufferAccess an index past the vertex buffer reads out of bounds, so the referenced indices are
+// checked against it too
+bool draw_indexed_valid(const CaptureDrawIndexed &draw, const CaptureFile &capture, const FrameState &state,
+                        IndexRangeCache &index_ranges)
+{
+    if (!draw_state_complete(state) || !state.index_buffer.bound)
+    {
+        return false;
+    }
+
+    const BoundBuffer &bound = state.index_buffer;
+    const std::vector<uint8_t> &data = capture.buffers[bound.id].data;
+    const uint64_t size = index_size(bound.index_type);
+    if ((uint64_t)draw.first_index + draw.index_count > (data.size() - bound.offset) / size)
+    {
+        return false;
+    }
+    if (draw.index_count == 0)
+    {
+        return true;
+    }
+
+    IndexRangeKey key{bound.id, bound.offset, bound.index_type, draw.first_index, draw.index_count};
+    auto it = index_ranges.find(key);
+    if (it == index_ranges.end())
+    {
+        uint32_t min_index = std::numeric_limits<uint32_t>::max();
+        uint32_t max_index = 0;
+        const uint8_t *indices = data.data() + bound.offset + draw.first_index * size;
+        for (uint32_t i = 0; i < draw.index_count; i++)
+        {
+            uint32_t index = 0;
+            if (size == 2)
+            {
+                uint16_t index16;
+                memcpy(&index16, indices + i * size, sizeof(index16));
+                index = index16;
+            }
+            else
+            {
+                memcpy(&index, indices + i * size, sizeof(index));
+            }
+            min_index = std::min(min_index, index);
+            max_index = std::max(max_index, index);
+        }
+        it = index_ranges.emplace(key, std::make_pair(min_index, max_index)).first;
+    }
+
+    const int64_t first_vertex = (int64_t)it->second.first + draw.vertex_offset;
+    const int64_t last_vertex = (int64_t)it->second.second + draw.vertex_offset;
+    return first_vertex >= 0 && (uint64_t)last_vertex < bound_vertex_count(capture, state);
+}
+
+// checks the op against the resources defined so far and the frame's state, and updates the state
+bool validate_command(CaptureOp op, ParseCursor &cursor, const CaptureFile &capture, FrameState &state,
+                      IndexRangeCache &index_ranges)
+{
+    switch (op)
+    {
+    case CaptureOp::BeginRenderPass: {
+        CaptureRenderPass render_pass;
+        bool ok = cursor.read(&render_pass, sizeof(render_pass)) && !state.in_render_pass &&
+                  render_pass.width > 0 && render_pass.height > 0;
+        state.in_render_pass = true;
+        return ok;
+    }
+    case CaptureOp::EndRenderPass: {
+        bool ok = state.in_render_pass;
+        state.in_render_pass = false;
+        return ok;
+    }
+    case CaptureOp::BindPipeline: {
+        uint32_t id;
+        state.pipeline = true;
+        return cursor.read(&id, sizeof(id)) && id < capture.pipelines.size();
+    }
+    case CaptureOp::SetViewport: {
+        CaptureViewport viewport;
+        state.viewport = true;
+        return cursor.read(&viewport, sizeof(viewport)) && viewport.width > 0.0f && viewport.height != 0.0f &&
+               viewport.min_depth >= 0.0f && viewport.min_depth <= 1.0f && viewport.max_depth >= 0.0f &&
+               viewport.max_depth <= 1.0f;
+    }
+    case CaptureOp::SetScissor: {
+        CaptureScissor scissor;
+        state.scissor = true;
+        return cursor.read(&scissor, sizeof(scissor)) && scissor.x >= 0 && scissor.y >= 0 &&
+               (int64_t)scissor.x + scissor.width <= std::numeric_limits<int32_t>::max() &&
+               (int64_t)scissor.y + scissor.height <= std::numeric_limits<int32_t>::max();
+    }
+    case CaptureOp::BindVertexBuffer: {
+        CaptureBindBuffer bind;
+        if (!cursor.read(&bind, sizeof(bind)) || bind.id >= capture.buffers.size() ||
+            bind.offset >= capture.buffers[bind.id].data.size())
+        {
+            return false;
+        }
+        state.vertex_buffer = {true, bind.id, bind.offset, 0};
+        return true;
+    }
+    case CaptureOp::BindIndexBuffer: {
+        CaptureBindBuffer bind;
+        if (!cursor.read(&bind, sizeof(bind)) || bind.id >= capture.buffers.size() ||
+            (bind.index_type != VK_INDEX_TYPE_UINT16 && bind.index_type != VK_INDEX_TYPE_UINT32) ||
+            bind.offset >= capture.buffers[bind.id].data.size() || bind.offset % index_size(bind.index_type) != 0)
+        {
+            return false;
+        }
+        state.index_buffer = {true, bind.id, bind.offset, bind.index_type};
+        return true;
+    }
+    case CaptureOp::BindDescriptorSet:
+        state.descriptor_set = true;
+        return true;
+    case CaptureOp::BindUniforms:
+        state.uniforms = true;
+        return cursor.skip(sizeof(CaptureUniforms));
+    case CaptureOp::PushConstants:
+        state.push_constants = true;
+        return cursor.skip(sizeof(DrawPushConstants));
+    case CaptureOp::Draw: {
+        CaptureDraw draw;
+        return cursor.read(&draw, sizeof(draw)) && draw_valid(draw, capture, state);
+    }
+    case CaptureOp::DrawIndexed: {
+        CaptureDrawIndexed draw;
+        return cursor.read(&draw, sizeof(draw)) && draw_indexed_valid(draw, capture, state, index_ranges);
+    }
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+PipelineKey capture_pipeline_key(const CapturePipeline &pipeline)
+{
+    PipelineKey key{};
+    key.cull_mode = vk::CullModeFlags(pipeline.cull_mode);
+    key.front_face = (vk::FrontFace)pipeline.front_face;
+    key.polygon_mode = (vk::PolygonMode)pipeline.polygon_mode;
+    key.blend_enable = pipeline.blend_enable != 0;
+    key.frag_specialization.use_texture = pipeline.use_texture;
+    key.frag_specialization.desaturate = pipeline.desaturate;
+    return key;
+}
+
+bool CaptureWriter::open(const std::string &path)
+{
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    file.write(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+    file.write((const char *)&CAPTURE_VERSION, sizeof(CAPTURE_VERSION));
+    return true;
+}
+
+void CaptureWriter::close()
+{
+    file.close();
+    frame.clear();
+    resources.clear();
+    buffers.clear();
+    pipeline_ids.clear();
+    buffers_written = 0;
+}
+
+void CaptureWriter::append(const void *data, size_t size)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    frame.insert(frame.end(), bytes, bytes + size);
+}
+
+void CaptureWriter::write_target(vk::Format format, vk::Extent2D extent)
+{
+    CaptureTarget target{(uint32_t)format, extent.width, extent.height};
+    file.put((char)CaptureOp::Target);
+    file.write((const char *)&target, sizeof(target));
+}
+
+void CaptureWriter::write_shaders(const std::vector<uint8_t> &vert_code, const std::vector<uint8_t> &frag_code)
+{
+    file.put((char)CaptureOp::Shaders);
+    for (const auto *code : {&vert_code, &frag_code})
+    {
+        uint64_t size = code->size();
+        file.write((const char *)&size, sizeof(size));
+        file.write((const char *)code->data(), (std::streamsize)size);
+    }
+}
+
+void CaptureWriter::register_buffer(vk::Buffer buffer, uint32_t usage, const void *data, size_t size)
+{
+    PendingBuffer pending{};
+    pending.id = 0; // assigned when first written
+    pending.usage = usage;
+    pending.written = false;
+    pending.data.assign((const uint8_t *)data, (const uint8_t *)data + size);
+    buffers[static_cast<VkBuffer>(buffer)] = std::move(pending);
+}
+
+uint32_t CaptureWriter::buffer_id(vk::Buffer buffer)
+{
+    auto it = buffers.find(static_cast<VkBuffer>(buffer));
+    if (it == buffers.end())
+    {
+        // not registered, the replay will see an empty buffer
+        register_buffer(buffer, 0, nullptr, 0);
+        it = buffers.find(static_cast<VkBuffer>(buffer));
+    }
+
+    PendingBuffer &pending = it->second;
+    if (!pending.written)
+    {
+        pending.id = buffers_written++;
+        CaptureBufferHeader header{pending.id, pending.usage, pending.data.size()};
+        resources.push_back((uint8_t)CaptureOp::Buffer);
+        resources.insert(resources.end(), (const uint8_t *)&header, (const uint8_t *)&header + sizeof(header));
+        resources.insert(resources.end(), pending.data.begin(), pending.data.end());
+
+        pending.written = true;
+        pending.data = std::vector<uint8_t>();
+    }
+
+    return pending.id;
+}
+
+void CaptureWriter::begin_frame()
+{
+    frame.clear();
+    resources.clear();
+    frame.push_back((uint8_t)CaptureOp::FrameBegin);
+}
+
+void CaptureWriter::end_frame()
+{
+    frame.push_back((uint8_t)CaptureOp::FrameEnd);
+    file.write((const char *)resources.data(), (std::streamsize)resources.size());
+    file.write((const char *)frame.data(), (std::streamsize)frame.size());
+    frame_count++;
+}
+
+void CaptureWriter::begin_render_pass(vk::Extent2D extent, const float clear_color[4])
+{
+    CaptureRenderPass render_pass{extent.width, extent.height, {}};
+    memcpy(render_pass.clear_color, clear_color, sizeof(render_pass.clear_color));
+    write(CaptureOp::BeginRenderPass, render_pass);
+}
+
+void CaptureWriter::end_render_pass()
+{
+    frame.push_back((uint8_t)CaptureOp::EndRenderPass);
+}
+
+void CaptureWriter::bind_pipeline(uint64_t hash, const PipelineKey &key)
+{
+    auto it = pipeline_ids.find(hash);
+    if (it == pipeline_ids.end())
+    {
+        CapturePipeline pipeline{};
+        pipeline.id = (uint32_t)pipeline_ids.size();
+        pipeline.cull_mode = static_cast<VkCullModeFlags>(key.cull_mode);
+        pipeline.front_face = (uint32_t)key.front_face;
+        pipeline.polygon_mode = (uint32_t)key.polygon_mode;
+        pipeline.blend_enable = key.blend_enable;
+        pipeline.use_texture = key.frag_specialization.use_texture;
+        pipeline.desaturate = key.frag_specialization.desaturate;
+
+        resources.push_back((uint8_t)CaptureOp::Pipeline);
+        resources.insert(resources.end(), (const uint8_t *)&pipeline, (const uint8_t *)&pipeline + sizeof(pipeline));
+
+        it = pipeline_ids.emplace(hash, pipeline.id).first;
+    }
+
+    write(CaptureOp::BindPipeline, it->second);
+}
+
+void CaptureWriter::set_viewport(const vk::Viewport &viewport)
+{
+    CaptureViewport v{viewport.x, viewport.y, viewport.width, viewport.height, viewport.minDepth, viewport.maxDepth};
+    write(CaptureOp::SetViewport, v);
+}
+
+void CaptureWriter::set_scissor(const vk::Rect2D &scissor)
+{
+    CaptureScissor s{scissor.offset.x, scissor.offset.y, scissor.extent.width, scissor.extent.height};
+    write(CaptureOp::SetScissor, s);
+}
+
+void CaptureWriter::bind_vertex_buffer(vk::Buffer buffer, vk::DeviceSize offset)
+{
+    CaptureBindBuffer bind{buffer_id(buffer), 0, offset};
+    write(CaptureOp::BindVertexBuffer, bind);
+}
+
+void CaptureWriter::bind_index_buffer(vk::Buffer buffer, vk::DeviceSize offset, vk::IndexType index_type)
+{
+    CaptureBindBuffer bind{buffer_id(buffer), (uint32_t)index_type, offset};
+    write(CaptureOp::BindIndexBuffer, bind);
+}
+
+void CaptureWriter::bind_descriptor_set()
+{
+    frame.push_back((uint8_t)CaptureOp::BindDescriptorSet);
+}
+
+void CaptureWriter::bind_uniforms(const DrawUniforms &block)
+{
+    write(CaptureOp::BindUniforms, CaptureUniforms{block});
+}
+
+void CaptureWriter::push_constants(const DrawPushConstants &constants)
+{
+    write(CaptureOp::PushConstants, constants);
+}
+
+void CaptureWriter::draw(uint32_t vertex_count, uint32_t instance_count, uint32_t first_vertex, uint32_t first_instance)
+{
+    CaptureDraw d{vertex_count, instance_count, first_vertex, first_instance};
+    write(CaptureOp::Draw, d);
+}
+
+void CaptureWriter::draw_indexed(uint32_t index_count, uint32_t instance_count, uint32_t first_index,
+                                 int32_t vertex_offset, uint32_t first_instance)
+{
+    CaptureDrawIndexed d{index_count, instance_count, first_index, vertex_offset, first_instance};
+    write(CaptureOp::DrawIndexed, d);
+}
+
+bool read_capture(const std::string &path, CaptureFile &capture, std::string &error)
+{
+    std::ifstream f(path, std::ios::binary);
+    if (!f.is_open())
+    {
+        error = "failed to open file";
+        return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+
+    ParseCursor cursor{data.data(), data.data() + data.size()};
+
+    char magic[sizeof(CAPTURE_MAGIC)];
+    uint32_t version;
+    if (!cursor.read(magic, sizeof(magic)) || memcmp(magic, CAPTURE_MAGIC, sizeof(magic)) != 0 ||
+        !cursor.read(&version, sizeof(version)))
+    {
+        error = "not a capture file";
+        return false;
+    }
+
+    if (version != CAPTURE_VERSION)
+    {
+        error = "unsupported capture version " + std::to_string(version);
+        return false;
+    }
+
+    bool has_target = false;
+    bool has_shaders = false;
+    const uint8_t *frame_start = nullptr;
+    FrameState frame_state;
+    IndexRangeCache index_ranges;
+
+    while (cursor.pos < cursor.end)
+    {
+        CaptureOp op = (CaptureOp)*cursor.pos++;
+        bool ok = true;
+
+        switch (op)
+        {
+        case CaptureOp::Target:
+            ok = cursor.read(&capture.target, sizeof(capture.target)) && capture.target.width > 0 &&
+                 capture.target.height > 0;
+            has_target = true;
+            break;
+        case CaptureOp::Shaders:
+            ok = cursor.read_blob(capture.vert_code) && cursor.read_blob(capture.frag_code);
+            has_shaders = true;
+            break;
+        case CaptureOp::Pipeline: {
+            CapturePipeline pipeline;
+            ok = frame_start == nullptr && cursor.read(&pipeline, sizeof(pipeline)) &&
+                 pipeline.id == capture.pipelines.size() && pipeline_valid(pipeline);
+            capture.pipelines.push_back(pipeline);
+            break;
+        }
+        case CaptureOp::Buffer: {
+            CaptureBufferHeader header;
+            ok = frame_start == nullptr && cursor.read(&header, sizeof(header)) &&
+                 header.id == capture.buffers.size() && (uint64_t)(cursor.end - cursor.pos) >= header.size;
+            if (ok)
+            {
+                capture.buffers.push_back({header.id, header.usage, {cursor.pos, cursor.pos + header.size}});
+                cursor.pos += header.size;
+            }
+            break;
+        }
+        case CaptureOp::FrameBegin:
+            ok = frame_start == nullptr;
+            frame_start = cursor.pos;
+            frame_state = FrameState{};
+            break;
+        case CaptureOp::FrameEnd:
+            ok = frame_start != nullptr && !frame_state.in_render_pass;
+            if (ok)
+            {
+                capture.frames.emplace_back(frame_start, cursor.pos - 1);
+                frame_start = nullptr;
+            }
+            break;
+        default:
+            ok = frame_start != nullptr && validate_command(op, cursor, capture, frame_state, index_ranges);
+            break;
+        }
+
+        if (!ok)
+        {
+            error = "malformed or truncated capture at offset " + std::to_string(cursor.pos - data.data());
+            return false;
+        }
+    }
+
+    if (frame_start != nullptr)
+    {
+        error = "capture ends inside a frame";
+        return false;
+    }
+
+    if (!has_target || !has_shaders)
+    {
+        error = "capture is missing its target or shaders";
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+#include "pipelines.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Binary capture of the command stream recorded by record_command_buffer(), replayed by tools/replay.
+// A file is a magic and version followed by ops, each an op byte and a fixed payload. Resources (pipelines,
+// buffers) are written once, right before the first frame that uses them, and numbered in the order they are
+// written so an id is the resource's index.
+
+const uint32_t CAPTURE_VERSION = 2;
+
+enum class CaptureOp : uint8_t
+{
+    Target = 1,
+    Shaders,
+    Pipeline,
+    Buffer,
+    FrameBegin,
+    FrameEnd,
+    BeginRenderPass,
+    EndRenderPass,
+    BindPipeline,
+    SetViewport,
+    SetScissor,
+    BindVertexBuffer,
+    BindIndexBuffer,
+    BindDescriptorSet,
+    Draw,
+    DrawIndexed,
+    BindUniforms,
+    PushConstants,
+};
+
+const uint32_t CAPTURE_BUFFER_VERTEX = 1;
+const uint32_t CAPTURE_BUFFER_INDEX = 2;
+
+struct CaptureTarget
+{
+    uint32_t format; // VkFormat of the color attachment
+    uint32_t width;
+    uint32_t height;
+};
+
+struct CapturePipeline
+{
+    uint32_t id;
+    uint32_t cull_mode;
+    uint32_t front_face;
+    uint32_t polygon_mode;
+    uint32_t blend_enable;
+    uint32_t use_texture;
+    uint32_t desaturate;
+};
+
+struct CaptureBufferHeader
+{
+    uint32_t id;
+    uint32_t usage;
+    uint64_t size; // followed by size bytes of contents
+};
+
+struct CaptureRenderPass
+{
+    uint32_t width;
+    uint32_t height;
+    float clear_color[4];
+};
+
+struct CaptureViewport
+{
+    float x, y, width, height, min_depth, max_depth;
+};
+
+struct CaptureScissor
+{
+    int32_t x, y;
+    uint32_t width, height;
+};
+
+struct CaptureBindBuffer
+{
+    uint32_t id;
+    uint32_t index_type; // VkIndexType, index buffers only
+    uint64_t offset;
+};
+
+struct CaptureDraw
+{
+    uint32_t vertex_count, instance_count, first_vertex, first_instance;
+};
+
+struct CaptureDrawIndexed
+{
+    uint32_t index_count, instance_count, first_index;
+    int32_t vertex_offset;
+    uint32_t first_instance;
+};
+
+// the uniform block itself rather than its dynamic offset, the replay lays out its own uniform buffer since the
+// offset alignment differs between devices
+struct CaptureUniforms
+{
+    DrawUniforms block;
+};
+
+PipelineKey capture_pipeline_key(const CapturePipeline &pipeline);
+
+class CaptureWriter
+{
+  public:
+    bool open(const std::string &path);
+    void close();
+
+    bool is_open() const
+    {
+        return file.is_open();
+    }
+
+    uint32_t frames_written() const
+    {
+        return frame_count;
+    }
+
+    void write_target(vk::Format format, vk::Extent2D extent);
+    void write_shaders(const std::vector<uint8_t> &vert_code, const std::vector<uint8_t> &frag_code);
+
+    // contents are kept until the buffer is first bound during a captured frame
+    void register_buffer(vk::Buffer buffer, uint32_t usage, const void *data, size_t size);
+
+    void begin_frame();
+    void end_frame(); // flushes the frame to disk
+
+    void begin_render_pass(vk::Extent2D extent, const float clear_color[4]);
+    void end_render_pass();
+    void bind_pipeline(uint64_t hash, const PipelineKey &key);
+    void set_viewport(const vk::Viewport &viewport);
+    void set_scissor(const vk::Rect2D &scissor);
+    void bind_vertex_buffer(vk::Buffer buffer, vk::DeviceSize offset);
+    void bind_index_buffer(vk::Buffer buffer, vk::DeviceSize offset, vk::IndexType index_type);
+    void bind_descriptor_set();
+    void bind_uniforms(const DrawUniforms &block);
+    void push_constants(const DrawPushConstants &constants);
+    void draw(uint32_t vertex_count, uint32_t instance_count, uint32_t first_vertex, uint32_t first_instance);
+    void draw_indexed(uint32_t index_count, uint32_t instance_count, uint32_t first_index, int32_t vertex_offset,
+                      uint32_t first_instance);
+
+  private:
+    struct PendingBuffer
+    {
+        uint32_t id;
+        uint32_t usage;
+        bool written;
+        std::vector<uint8_t> data;
+    };
+
+    template <typename T> void write(CaptureOp op, const T &payload)
+    {
+        frame.push_back((uint8_t)op);
+        append(&payload, sizeof(payload));
+    }
+
+    void append(const void *data, size_t size);
+    uint32_t buffer_id(vk::Buffer buffer);
+
+    std::ofstream file;
+    std::vector<uint8_t> frame; // ops of the current frame, written out in end_frame()
+    std::vector<uint8_t> resources; // resource definitions needed by the current frame
+    std::unordered_map<VkBuffer, PendingBuffer> buffers;
+    std::unordered_map<uint64_t, uint32_t> pipeline_ids;
+    uint32_t buffers_written = 0;
+    uint32_t frame_count = 0;
+};
+
+struct CaptureBuffer
+{
+    uint32_t id;
+    uint32_t usage;
+    std::vector<uint8_t> data;
+};
+
+struct CaptureFile
+{
+    CaptureTarget target;
+    std::vector<uint8_t> vert_code;
+    std::vector<uint8_t> frag_code;
+    std::vector<CapturePipeline> pipelines;
+    std::vector<CaptureBuffer> buffers;
+    std::vector<std::vector<uint8_t>> frames; // command ops between FrameBegin and FrameEnd, resources removed
+};
+
+// rejects files with resource ids out of order, enums or ranges the replay cannot pass to Vulkan, and frames that
+// reference a resource not defined before them, draw without the state they need or end inside a render pass
+bool read_capture(const std::string &path, CaptureFile &capture, std::string &error);
+
+// sequential reader over the ops of one frame
+class CaptureCursor
+{
+  public:
+    explicit CaptureCursor(const std::vector<uint8_t> &data) : pos(data.data()), end(data.data() + data.size())
+    {
+    }
+
+    bool done() const
+    {
+        return pos >= end;
+    }
+
+    CaptureOp next_op()
+    {
+        return (CaptureOp)*pos++;
+    }
+
+    template <typename T> T read()
+    {
+        T value;
+        memcpy(&value, pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+
+  private:
+    const uint8_t *pos;
+    const uint8_t *end;
+};
@@ -0,0 +1,106 @@
+#include "draw_list.h"
+
+#include <algorithm>
+
+namespace
+{
+
+const int PASS_SHIFT = 60;
+const int PIPELINE_SHIFT = 44;
+const int MATERIAL_SHIFT = 28;
+const int DEPTH_SHIFT = 12;
+
+const int RADIX_BITS = 8;
+const int RADIX_BUCKETS = 1 << RADIX_BITS;
+const int RADIX_PASSES = 64 / RADIX_BITS;
+
+} // namespace
+
+uint64_t make_draw_key(DrawPass pass, uint32_t pipeline, uint32_t material, float depth)
+{
+    uint32_t depth_bucket = (uint32_t)(std::clamp(depth, 0.0f, 1.0f) * 65535.0f);
+    if (pass == DrawPass::Transparent)
+    {
+        depth_bucket = 0xFFFF - depth_bucket;
+    }
+
+    return ((uint64_t)pass & 0xF) << PASS_SHIFT | ((uint64_t)pipeline & 0xFFFF) << PIPELINE_SHIFT |
+           ((uint64_t)material & 0xFFFF) << MATERIAL_SHIFT | (uint64_t)depth_bucket << DEPTH_SHIFT;
+}
+
+uint32_t draw_key_pipeline(uint64_t key)
+{
+    return (uint32_t)(key >> PIPELINE_SHIFT) & 0xFFFF;
+}
+
+uint32_t draw_key_material(uint64_t key)
+{
+    return (uint32_t)(key >> MATERIAL_SHIFT) & 0xFFFF;
+}
+
+void DrawList::clear()
+{
+    items.clear();
+    keys.clear();
+    order.clear();
+}
+
+void DrawList::add(const DrawItem &item)
+{
+    order.push_back((uint32_t)items.size());
+    keys.push_back(item.key);
+    items.push_back(item);
+}
+
+void DrawList::sort()
+{
+    const size_t count = keys.size();
+    if (count < 2)
+    {
+        return;
+    }
+
+    // one read of the keys builds the histograms of every pass
+    static_assert(RADIX_PASSES == 8, "64 bit keys in 8 bit digits");
+    uint32_t histograms[RADIX_PASSES][RADIX_BUCKETS] = {};
+    for (uint64_t key : keys)
+    {
+        for (int pass = 0; pass < RADIX_PASSES; pass++)
+        {
+            histograms[pass][(key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+        }
+    }
+
+    keys_scratch.resize(count);
+    order_scratch.resize(count);
+
+    for (int pass = 0; pass < RADIX_PASSES; pass++)
+    {
+        uint32_t *histogram = histograms[pass];
+        const int shift = pass * RADIX_BITS;
+
+        // every key has the same digit, the pass would not move anything
+        if (histogram[(keys[0] >> shift) & (RADIX_BUCKETS - 1)] == count)
+        {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (int bucket = 0; bucket < RADIX_BUCKETS; bucket++)
+        {
+            uint32_t n = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += n;
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            uint32_t dst = histogram[(keys[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+            keys_scratch[dst] = keys[i];
+            order_scratch[dst] = order[i];
+        }
+
+        keys.swap(keys_scratch);
+        order.swap(order_scratch);
+    }
+}
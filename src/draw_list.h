@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// most significant first: pass (4 bits) | pipeline (16) | material (16) | depth bucket (16) | unused (12)
+enum class DrawPass : uint8_t
+{
+    Opaque = 0,
+    Transparent = 1,
+};
+
+// depth is 0 (near) to 1 (far). Opaque draws write depth and sort front to back so hidden fragments fail the early
+// depth test, transparent ones only test it and sort back to front so they blend over each other in order.
+uint64_t make_draw_key(DrawPass pass, uint32_t pipeline, uint32_t material, float depth);
+
+uint32_t draw_key_pipeline(uint64_t key);
+uint32_t draw_key_material(uint64_t key);
+
+struct DrawItem
+{
+    uint64_t key;
+    uint32_t instance; // scene instance the draw belongs to
+    uint32_t index_count;
+    uint32_t first_index;
+    int32_t vertex_offset;
+    uint32_t uniform_offset; // dynamic offset of the draw's uniforms
+};
+
+// binds issued and skipped while recording one frame's draw list
+struct DrawStats
+{
+    uint32_t draws = 0;
+    uint32_t pipeline_binds = 0;
+    uint32_t pipeline_binds_skipped = 0;
+    uint32_t material_binds = 0;
+    uint32_t material_binds_skipped = 0;
+};
+
+// Draws of one frame, sorted by key so draws sharing a pipeline and material end up next to each other.
+// Storage is reused between frames.
+class DrawList
+{
+  public:
+    void clear();
+    void add(const DrawItem &item);
+
+    // stable LSD radix sort on the keys, 8 bits per pass, passes where every key has the same digit are skipped
+    void sort();
+
+    size_t size() const
+    {
+        return items.size();
+    }
+
+    // i-th draw in sorted order
+    const DrawItem &operator[](size_t i) const
+    {
+        return items[order[i]];
+    }
+
+  private:
+    std::vector<DrawItem> items;
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> order;
+    std::vector<uint64_t> keys_scratch;
+    std::vector<uint32_t> order_scratch;
+};
@@ -0,0 +1,359 @@
+#include "frustum_cull.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// clang contracts a * b + c into an FMA by default where the target has one (AArch64, x86 with FMA), which would
+// round the scalar kernel differently from the SIMD kernels' separate multiplies and adds
+#pragma STDC FP_CONTRACT OFF
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CULL_X86 1
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CULL_NEON 1
+#endif
+
+namespace
+{
+
+// every kernel evaluates ((a * x + b * y) + c * z) + d >= -r in the same order, so they agree bit for bit
+size_t cull_scalar(const Frustum &frustum, const InstanceStore &store, size_t begin, size_t end, uint32_t *visible)
+{
+    const float *x = store.center_x_data();
+    const float *y = store.center_y_data();
+    const float *z = store.center_z_data();
+    const float *r = store.radius_data();
+
+    size_t count = 0;
+    for (size_t i = begin; i < end; i++)
+    {
+        bool inside = true;
+        for (const auto &plane : frustum.planes)
+        {
+            float distance = plane[0] * x[i] + plane[1] * y[i] + plane[2] * z[i] + plane[3];
+            inside &= distance >= -r[i];
+        }
+
+        // branchless, the slot is overwritten by the next index if this one is culled
+        visible[count] = (uint32_t)i;
+        count += inside;
+    }
+    return count;
+}
+
+#if defined(CULL_X86) && defined(__SSE2__)
+#define CULL_SSE 1
+
+size_t cull_sse(const Frustum &frustum, const InstanceStore &store, size_t begin, size_t end, uint32_t *visible)
+{
+    const float *x = store.center_x_data();
+    const float *y = store.center_y_data();
+    const float *z = store.center_z_data();
+    const float *r = store.radius_data();
+
+    __m128 a[6], b[6], c[6], d[6];
+    for (int p = 0; p < 6; p++)
+    {
+        a[p] = _mm_set1_ps(frustum.planes[p][0]);
+        b[p] = _mm_set1_ps(frustum.planes[p][1]);
+        c[p] = _mm_set1_ps(frustum.planes[p][2]);
+        d[p] = _mm_set1_ps(frustum.planes[p][3]);
+    }
+    const __m128 zero = _mm_setzero_ps();
+
+    size_t count = 0;
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 cx = _mm_loadu_ps(x + i);
+        __m128 cy = _mm_loadu_ps(y + i);
+        __m128 cz = _mm_loadu_ps(z + i);
+        __m128 neg_r = _mm_sub_ps(zero, _mm_loadu_ps(r + i));
+
+        __m128 inside = _mm_cmpeq_ps(zero, zero);
+        for (int p = 0; p < 6; p++)
+        {
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[p], cx), _mm_mul_ps(b[p], cy)), _mm_mul_ps(c[p], cz)), d[p]);
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, neg_r));
+        }
+
+        unsigned mask = (unsigned)_mm_movemask_ps(inside);
+        while (mask != 0)
+        {
+            visible[count++] = (uint32_t)(i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+
+    return count + cull_scalar(frustum, store, i, end, visible + count);
+}
+#endif
+
+#if defined(CULL_X86)
+__attribute__((target("avx2"))) size_t cull_avx2(const Frustum &frustum, const InstanceStore &store, size_t begin,
+                                                 size_t end, uint32_t *visible)
+{
+    const float *x = store.center_x_data();
+    const float *y = store.center_y_data();
+    const float *z = store.center_z_data();
+    const float *r = store.radius_data();
+
+    __m256 a[6], b[6], c[6], d[6];
+    for (int p = 0; p < 6; p++)
+    {
+        a[p] = _mm256_set1_ps(frustum.planes[p][0]);
+        b[p] = _mm256_set1_ps(frustum.planes[p][1]);
+        c[p] = _mm256_set1_ps(frustum.planes[p][2]);
+        d[p] = _mm256_set1_ps(frustum.planes[p][3]);
+    }
+    const __m256 zero = _mm256_setzero_ps();
+
+    size_t count = 0;
+    size_t i = begin;
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256 cx = _mm256_loadu_ps(x + i);
+        __m256 cy = _mm256_loadu_ps(y + i);
+        __m256 cz = _mm256_loadu_ps(z + i);
+        __m256 neg_r = _mm256_sub_ps(zero, _mm256_loadu_ps(r + i));
+
+        __m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+        for (int p = 0; p < 6; p++)
+        {
+            // no FMA, it would round differently from the other kernels
+            __m256 distance = _mm256_add_ps(
+                _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a[p], cx), _mm256_mul_ps(b[p], cy)),
+                              _mm256_mul_ps(c[p], cz)),
+                d[p]);
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, neg_r, _CMP_GE_OQ));
+        }
+
+        unsigned mask = (unsigned)_mm256_movemask_ps(inside);
+        while (mask != 0)
+        {
+            visible[count++] = (uint32_t)(i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+
+    return count + cull_scalar(frustum, store, i, end, visible + count);
+}
+#endif
+
+#if defined(CULL_NEON)
+size_t cull_neon(const Frustum &frustum, const InstanceStore &store, size_t begin, size_t end, uint32_t *visible)
+{
+    const float *x = store.center_x_data();
+    const float *y = store.center_y_data();
+    const float *z = store.center_z_data();
+    const float *r = store.radius_data();
+
+    float32x4_t a[6], b[6], c[6], d[6];
+    for (int p = 0; p < 6; p++)
+    {
+        a[p] = vdupq_n_f32(frustum.planes[p][0]);
+        b[p] = vdupq_n_f32(frustum.planes[p][1]);
+        c[p] = vdupq_n_f32(frustum.planes[p][2]);
+        d[p] = vdupq_n_f32(frustum.planes[p][3]);
+    }
+    const uint32_t lane_bits_data[4] = {1, 2, 4, 8};
+    const uint32x4_t lane_bits = vld1q_u32(lane_bits_data);
+
+    size_t count = 0;
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4)
+    {
+        float32x4_t cx = vld1q_f32(x + i);
+        float32x4_t cy = vld1q_f32(y + i);
+        float32x4_t cz = vld1q_f32(z + i);
+        float32x4_t neg_r = vnegq_f32(vld1q_f32(r + i));
+
+        uint32x4_t inside = vdupq_n_u32(0xFFFFFFFFu);
+        for (int p = 0; p < 6; p++)
+        {
+            // vmlaq would fuse on AArch64, keep multiplies and adds separate like the other kernels
+            float32x4_t distance = vaddq_f32(
+                vaddq_f32(vaddq_f32(vmulq_f32(a[p], cx), vmulq_f32(b[p], cy)), vmulq_f32(c[p], cz)), d[p]);
+            inside = vandq_u32(inside, vcgeq_f32(distance, neg_r));
+        }
+
+        unsigned mask = vaddvq_u32(vandq_u32(inside, lane_bits));
+        while (mask != 0)
+        {
+            visible[count++] = (uint32_t)(i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+
+    return count + cull_scalar(frustum, store, i, end, visible + count);
+}
+#endif
+
+} // namespace
+
+Frustum frustum_from_matrix(const float m[16])
+{
+    // rows of the column-major matrix
+    float row[4][4];
+    for (int r = 0; r < 4; r++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            row[r][c] = m[c * 4 + r];
+        }
+    }
+
+    Frustum frustum{};
+    for (int i = 0; i < 4; i++)
+    {
+        frustum.planes[0][i] = row[3][i] + row[0][i]; // left, -w <= x
+        frustum.planes[1][i] = row[3][i] - row[0][i]; // right, x <= w
+        frustum.planes[2][i] = row[3][i] + row[1][i]; // top, -w <= y
+        frustum.planes[3][i] = row[3][i] - row[1][i]; // bottom, y <= w
+        frustum.planes[4][i] = row[2][i];             // near, 0 <= z
+        frustum.planes[5][i] = row[3][i] - row[2][i]; // far, z <= w
+    }
+
+    for (auto &plane : frustum.planes)
+    {
+        float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (length > 0.0f)
+        {
+            for (float &v : plane)
+            {
+                v /= length;
+            }
+        }
+    }
+
+    return frustum;
+}
+
+const char *cull_kernel_name(CullKernel kernel)
+{
+    switch (kernel)
+    {
+    case CullKernel::Scalar:
+        return "scalar";
+    case CullKernel::Sse:
+        return "sse";
+    case CullKernel::Avx2:
+        return "avx2";
+    case CullKernel::Neon:
+        return "neon";
+    }
+    return "unknown";
+}
+
+bool cull_kernel_supported(CullKernel kernel)
+{
+    switch (kernel)
+    {
+    case CullKernel::Scalar:
+        return true;
+    case CullKernel::Sse:
+#if defined(CULL_SSE)
+        return true;
+#else
+        return false;
+#endif
+    case CullKernel::Avx2:
+#if defined(CULL_X86)
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    case CullKernel::Neon:
+#if defined(CULL_NEON)
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+CullKernel best_cull_kernel()
+{
+    for (CullKernel kernel : {CullKernel::Avx2, CullKernel::Neon, CullKernel::Sse})
+    {
+        if (cull_kernel_supported(kernel))
+        {
+            return kernel;
+        }
+    }
+    return CullKernel::Scalar;
+}
+
+size_t cull_spheres(CullKernel kernel, const Frustum &frustum, const InstanceStore &store, size_t begin, size_t end,
+                    uint32_t *visible)
+{
+    switch (kernel)
+    {
+#if defined(CULL_SSE)
+    case CullKernel::Sse:
+        return cull_sse(frustum, store, begin, end, visible);
+#endif
+#if defined(CULL_X86)
+    case CullKernel::Avx2:
+        return cull_avx2(frustum, store, begin, end, visible);
+#endif
+#if defined(CULL_NEON)
+    case CullKernel::Neon:
+        return cull_neon(frustum, store, begin, end, visible);
+#endif
+    default:
+        return cull_scalar(frustum, store, begin, end, visible);
+    }
+}
+
+void FrustumCuller::init(uint32_t thread_count, CullKernel kernel)
+{
+    active_kernel = cull_kernel_supported(kernel) ? kernel : CullKernel::Scalar;
+    pool.start(thread_count);
+}
+
+void FrustumCuller::destroy()
+{
+    pool.stop();
+}
+
+void FrustumCuller::cull(const Frustum &frustum, const InstanceStore &store, std::vector<uint32_t> &visible)
+{
+    const size_t instance_count = store.size();
+    visible.resize(instance_count);
+
+    const size_t chunk_count = (instance_count + CULL_CHUNK_SIZE - 1) / CULL_CHUNK_SIZE;
+    if (chunk_count <= 1 || pool.thread_count() == 0)
+    {
+        visible.resize(cull_spheres(active_kernel, frustum, store, 0, instance_count, visible.data()));
+        return;
+    }
+
+    // every chunk writes to its own range of visible, compacted afterwards
+    chunk_counts.resize(chunk_count);
+    for (size_t chunk = 0; chunk < chunk_count; chunk++)
+    {
+        pool.submit([&, chunk] {
+            size_t begin = chunk * CULL_CHUNK_SIZE;
+            size_t end = std::min(begin + CULL_CHUNK_SIZE, instance_count);
+            chunk_counts[chunk] = cull_spheres(active_kernel, frustum, store, begin, end, visible.data() + begin);
+        });
+    }
+    pool.wait_idle();
+
+    size_t total = chunk_counts[0];
+    for (size_t chunk = 1; chunk < chunk_count; chunk++)
+    {
+        memmove(visible.data() + total, visible.data() + chunk * CULL_CHUNK_SIZE,
+                chunk_counts[chunk] * sizeof(uint32_t));
+        total += chunk_counts[chunk];
+    }
+    visible.resize(total);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "instance_store.h"
+#include "thread_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// instances per job, a multiple of every kernel width
+const size_t CULL_CHUNK_SIZE = 4096;
+
+// a * x + b * y + c * z + d >= 0 inside, (a, b, c) normalized
+struct Frustum
+{
+    float planes[6][4];
+};
+
+// planes of a column-major view projection matrix with Vulkan clip space, 0 <= z <= w
+Frustum frustum_from_matrix(const float m[16]);
+
+enum class CullKernel
+{
+    Scalar,
+    Sse,
+    Avx2,
+    Neon,
+};
+
+const char *cull_kernel_name(CullKernel kernel);
+
+// compiled in and supported by the CPU running this
+bool cull_kernel_supported(CullKernel kernel);
+
+CullKernel best_cull_kernel();
+
+// writes the indices of the spheres in [begin, end) that intersect the frustum to visible in ascending order,
+// returns their count. visible needs room for end - begin indices.
+size_t cull_spheres(CullKernel kernel, const Frustum &frustum, const InstanceStore &store, size_t begin, size_t end,
+                    uint32_t *visible);
+
+// splits the store into CULL_CHUNK_SIZE jobs over its own threads, stores of a single chunk are culled on the
+// calling thread
+class FrustumCuller
+{
+  public:
+    void init(uint32_t thread_count, CullKernel kernel = best_cull_kernel());
+    void destroy();
+
+    // visible is replaced by the visible indices in ascending order, its capacity is reused between calls
+    void cull(const Frustum &frustum, const InstanceStore &store, std::vector<uint32_t> &visible);
+
+    CullKernel kernel() const
+    {
+        return active_kernel;
+    }
+
+    uint32_t thread_count() const
+    {
+        return pool.thread_count();
+    }
+
+  private:
+    ThreadPool pool;
+    CullKernel active_kernel = CullKernel::Scalar;
+    std::vector<size_t> chunk_counts;
+};
@@ -0,0 +1,26 @@
+#include "instance_store.h"
+
+uint32_t InstanceStore::add(const float center[3], float radius)
+{
+    center_x.push_back(center[0]);
+    center_y.push_back(center[1]);
+    center_z.push_back(center[2]);
+    this->radius.push_back(radius);
+    return (uint32_t)(size() - 1);
+}
+
+void InstanceStore::set_bounds(uint32_t index, const float center[3], float radius)
+{
+    center_x[index] = center[0];
+    center_y[index] = center[1];
+    center_z[index] = center[2];
+    this->radius[index] = radius;
+}
+
+void InstanceStore::clear()
+{
+    center_x.clear();
+    center_y.clear();
+    center_z.clear();
+    radius.clear();
+}
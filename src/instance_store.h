@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// 32 bytes, the width of the AVX2 culling kernel
+const size_t INSTANCE_STORE_ALIGNMENT = 32;
+
+template <typename T, size_t Alignment> struct AlignedAllocator
+{
+    using value_type = T;
+
+    template <typename U> struct rebind
+    {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() = default;
+
+    template <typename U> AlignedAllocator(const AlignedAllocator<U, Alignment> &)
+    {
+    }
+
+    T *allocate(size_t n)
+    {
+        // aligned_alloc wants the size to be a multiple of the alignment
+        size_t size = (n * sizeof(T) + Alignment - 1) / Alignment * Alignment;
+        void *p = aligned_alloc(Alignment, size);
+        if (p == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        return (T *)p;
+    }
+
+    void deallocate(T *p, size_t)
+    {
+        free(p);
+    }
+
+    template <typename U> bool operator==(const AlignedAllocator<U, Alignment> &) const
+    {
+        return true;
+    }
+
+    template <typename U> bool operator!=(const AlignedAllocator<U, Alignment> &) const
+    {
+        return false;
+    }
+};
+
+using AlignedFloats = std::vector<float, AlignedAllocator<float, INSTANCE_STORE_ALIGNMENT>>;
+
+// Bounding spheres of every object in the scene as a structure of arrays, so the culling kernels load one
+// component of several objects per instruction. The index of an instance is stable until clear().
+class InstanceStore
+{
+  public:
+    uint32_t add(const float center[3], float radius);
+    void set_bounds(uint32_t index, const float center[3], float radius);
+    void clear();
+
+    size_t size() const
+    {
+        return radius.size();
+    }
+
+    const float *center_x_data() const
+    {
+        return center_x.data();
+    }
+
+    const float *center_y_data() const
+    {
+        return center_y.data();
+    }
+
+    const float *center_z_data() const
+    {
+        return center_z.data();
+    }
+
+    const float *radius_data() const
+    {
+        return radius.data();
+    }
+
+  private:
+    AlignedFloats center_x;
+    AlignedFloats center_y;
+    AlignedFloats center_z;
+    AlignedFloats radius;
+};
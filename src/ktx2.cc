@@ -0,0 +1,192 @@
+#include "ktx2.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+
+const uint8_t KTX2_IDENTIFIER[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+struct Ktx2Header
+{
+    uint8_t identifier[12];
+    uint32_t vk_format;
+    uint32_t type_size;
+    uint32_t pixel_width;
+    uint32_t pixel_height;
+    uint32_t pixel_depth;
+    uint32_t layer_count;
+    uint32_t face_count;
+    uint32_t level_count;
+    uint32_t supercompression_scheme;
+
+    uint32_t dfd_byte_offset;
+    uint32_t dfd_byte_length;
+    uint32_t kvd_byte_offset;
+    uint32_t kvd_byte_length;
+    uint64_t sgd_byte_offset;
+    uint64_t sgd_byte_length;
+};
+static_assert(sizeof(Ktx2Header) == 80, "KTX2 header must be tightly packed");
+
+struct Ktx2LevelIndex
+{
+    uint64_t byte_offset;
+    uint64_t byte_length;
+    uint64_t uncompressed_byte_length;
+};
+
+struct Ktx2FormatBlock
+{
+    uint32_t vk_format;
+    uint32_t block_width;
+    uint32_t block_height;
+    uint32_t block_bytes;
+};
+
+// VkFormat values of the formats whose level sizes can be checked, this file does not include the Vulkan headers
+const Ktx2FormatBlock KTX2_FORMAT_BLOCKS[] = {
+    {37, 1, 1, 4},   // R8G8B8A8_UNORM
+    {43, 1, 1, 4},   // R8G8B8A8_SRGB
+    {131, 4, 4, 8},  // BC1_RGB_UNORM_BLOCK
+    {132, 4, 4, 8},  // BC1_RGB_SRGB_BLOCK
+    {133, 4, 4, 8},  // BC1_RGBA_UNORM_BLOCK
+    {134, 4, 4, 8},  // BC1_RGBA_SRGB_BLOCK
+    {145, 4, 4, 16}, // BC7_UNORM_BLOCK
+    {146, 4, 4, 16}, // BC7_SRGB_BLOCK
+    {147, 4, 4, 8},  // ETC2_R8G8B8_UNORM_BLOCK
+    {148, 4, 4, 8},  // ETC2_R8G8B8_SRGB_BLOCK
+    {149, 4, 4, 8},  // ETC2_R8G8B8A1_UNORM_BLOCK
+    {150, 4, 4, 8},  // ETC2_R8G8B8A1_SRGB_BLOCK
+    {151, 4, 4, 16}, // ETC2_R8G8B8A8_UNORM_BLOCK
+    {152, 4, 4, 16}, // ETC2_R8G8B8A8_SRGB_BLOCK
+};
+
+const Ktx2FormatBlock *find_format_block(uint32_t vk_format)
+{
+    for (const auto &block : KTX2_FORMAT_BLOCKS)
+    {
+        if (block.vk_format == vk_format)
+        {
+            return &block;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace
+
+bool read_ktx2_info(const std::string &path, Ktx2Info &info, std::string &error)
+{
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    if (!f.is_open())
+    {
+        error = "failed to open file";
+        return false;
+    }
+    uint64_t file_size = (uint64_t)f.tellg();
+    f.seekg(0);
+
+    Ktx2Header header{};
+    if (!f.read((char *)&header, sizeof(header)))
+    {
+        error = "truncated header";
+        return false;
+    }
+
+    if (memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+    {
+        error = "not a KTX2 file";
+        return false;
+    }
+
+    if (header.supercompression_scheme != 0)
+    {
+        error = "supercompressed KTX2 files are not supported";
+        return false;
+    }
+
+    if (header.pixel_width == 0 || header.pixel_height == 0 || header.pixel_depth != 0 || header.layer_count > 1 || header.face_count != 1)
+    {
+        error = "only 2D textures are supported";
+        return false;
+    }
+
+    const Ktx2FormatBlock *block = find_format_block(header.vk_format);
+    if (block == nullptr)
+    {
+        error = "unsupported format " + std::to_string(header.vk_format);
+        return false;
+    }
+
+    // a full chain ends at 1x1, more levels than that is a corrupt header
+    uint32_t max_level_count = 1;
+    for (uint32_t size = std::max(header.pixel_width, header.pixel_height); size > 1; size >>= 1)
+    {
+        max_level_count++;
+    }
+
+    uint32_t level_count = std::max(header.level_count, 1u);
+    if (level_count > max_level_count)
+    {
+        error = "too many levels for the image size";
+        return false;
+    }
+
+    std::vector<Ktx2LevelIndex> level_index(level_count);
+    if (!f.read((char *)level_index.data(), sizeof(Ktx2LevelIndex) * level_count))
+    {
+        error = "truncated level index";
+        return false;
+    }
+
+    info.path = path;
+    info.vk_format = header.vk_format;
+    info.width = header.pixel_width;
+    info.height = header.pixel_height;
+    info.levels.resize(level_count);
+
+    for (uint32_t i = 0; i < level_count; i++)
+    {
+        const uint64_t byte_offset = level_index[i].byte_offset;
+        const uint64_t byte_length = level_index[i].byte_length;
+        if (byte_length > file_size || byte_offset > file_size - byte_length)
+        {
+            error = "level " + std::to_string(i) + " is out of bounds";
+            return false;
+        }
+
+        // the whole level extent is copied to the image, a short level would make the copy read past its data
+        uint64_t blocks_x = (ktx2_level_width(info, i) + block->block_width - 1) / block->block_width;
+        uint64_t blocks_y = (ktx2_level_height(info, i) + block->block_height - 1) / block->block_height;
+        if (byte_length < blocks_x * blocks_y * block->block_bytes)
+        {
+            error = "level " + std::to_string(i) + " is smaller than its extent";
+            return false;
+        }
+
+        info.levels[i].byte_offset = level_index[i].byte_offset;
+        info.levels[i].byte_length = level_index[i].byte_length;
+    }
+
+    return true;
+}
+
+bool read_ktx2_level(std::ifstream &file, const Ktx2Info &info, uint32_t level, void *dst)
+{
+    const Ktx2Level &l = info.levels[level];
+    file.seekg((std::streamoff)l.byte_offset);
+    return (bool)file.read((char *)dst, (std::streamsize)l.byte_length);
+}
+
+uint32_t ktx2_level_width(const Ktx2Info &info, uint32_t level)
+{
+    return std::max(info.width >> level, 1u);
+}
+
+uint32_t ktx2_level_height(const Ktx2Info &info, uint32_t level)
+{
+    return std::max(info.height >> level, 1u);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+struct Ktx2Level
+{
+    uint64_t byte_offset;
+    uint64_t byte_length;
+};
+
+// header and level index of a KTX2 file, level data is read separately so it can be streamed
+struct Ktx2Info
+{
+    std::string path;
+    uint32_t vk_format;
+    uint32_t width;
+    uint32_t height;
+    std::vector<Ktx2Level> levels; // level 0 is the most detailed
+};
+
+// only plain (not supercompressed) 2D textures without array layers or faces are supported, in RGBA8, BC1, BC7 or
+// ETC2 so every level can be checked to hold at least the data its extent needs
+bool read_ktx2_info(const std::string &path, Ktx2Info &info, std::string &error);
+
+bool read_ktx2_level(std::ifstream &file, const Ktx2Info &info, uint32_t level, void *dst);
+
+uint32_t ktx2_level_width(const Ktx2Info &info, uint32_t level);
+uint32_t ktx2_level_height(const Ktx2Info &info, uint32_t level);
@@ -1,16 +1,35 @@
-#define VULKAN_HPP_NO_EXCEPTIONS
-#define VULKAN_HPP_NO_SMART_HANDLE
-#define VULKAN_HPP_ASSERT_ON_RESULT
-#include <vulkan/vulkan.hpp>
-#include <vulkan/vulkan_handles.hpp>
+#include "vulkan_config.h"
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
+#include "capture.h"
+#include "draw_list.h"
+#include "frustum_cull.h"
+#include "ktx2.h"
+#include "mesh_optimizer.h"
+#include "metrics.h"
+#include "particles.h"
+#include "pipelines.h"
+#include "resolution_scale.h"
+#include "simulation.h"
+#include "staging_ring.h"
+#include "uniform_ring.h"
+
 const std::vector<const char *> VALIDATION_LAYERS = {"VK_LAYER_KHRONOS_validation"};
 
 #ifndef NDEBUG
@@ -19,17 +38,109 @@ const bool ENABLE_VALIDATION_LAYERS = true;
 const bool ENABLE_VALIDATION_LAYERS = false;
 #endif
 
+// overridden with LEARN_VULKAN_METRICS_SOCKET
+const char *METRICS_SOCKET_PATH = "/tmp/learn-vulkan.sock";
+
+const char *PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+const char *VERT_SHADER_PATH = "shaders/tri.vert.spv";
+const char *FRAG_SHADER_PATH = "shaders/tri.frag.spv";
+const char *PARTICLE_COMP_SHADER_PATH = "shaders/particles.comp.spv";
+const char *PARTICLE_VERT_SHADER_PATH = "shaders/particles.vert.spv";
+const char *PARTICLE_FRAG_SHADER_PATH = "shaders/particles.frag.spv";
+
+// LEARN_VULKAN_WINDOWS=<n> opens n windows, all rendered by the same device with one submit and one present
+const uint32_t MAX_WINDOWS = 8;
+const int WINDOW_WIDTH = 800;
+const int WINDOW_HEIGHT = 600;
+
+// bounds of the internal resolution relative to the window, overridden with LEARN_VULKAN_RENDER_SCALE_MIN/_MAX;
+// the scale is lowered in steps while the render passes take longer than LEARN_VULKAN_GPU_BUDGET_MS
+const float RENDER_SCALE_MIN = 0.5f;
+const float RENDER_SCALE_MAX = 1.0f;
+const float RENDER_SCALE_STEP = 0.125f;
+const float GPU_BUDGET_MS = 12.0f;
+
+// LEARN_VULKAN_INSTANCES=<n> adds n random copies of the mesh to the scene, culled and drawn every frame.
+// The uniform ring holds at most MAX_DRAWS_PER_FRAME blocks a frame, visible instances past it are culled only.
+const float SCENE_EXTENT = 2.0f;
+const uint32_t MAX_DRAWS_PER_FRAME = 16384;
+
+// draw_frame() waits for the previous frame before recording, per frame resources are split this many ways
+const uint32_t MAX_FRAMES_IN_FLIGHT = 1;
+
+// simulation rate independent of the frame rate, overridden with LEARN_VULKAN_SIM_HZ
+const double SIM_TICK_HZ = 60.0;
+
+// particles simulated on the compute queue and drawn as points, LEARN_VULKAN_PARTICLES=<n> overrides the count
+// and 0 disables them. A step covers the time since the last frame, capped so a stall does not fling them out.
+const uint32_t PARTICLE_DEFAULT_COUNT = 2 * 1024 * 1024;
+const float PARTICLE_DISK_RADIUS = 0.9f;
+const float PARTICLE_GRAVITY = 0.2f;
+const float PARTICLE_MAX_DT = 1.0f / 30.0f;
+
+// LEARN_VULKAN_CAPTURE=<path> records this many frames, LEARN_VULKAN_CAPTURE_FRAMES overrides
+const uint32_t CAPTURE_DEFAULT_FRAMES = 100;
+
+// loaded from TEXTURE_PATH + suffix, the first format the device can sample is used
+const char *TEXTURE_PATH = "textures/albedo";
+const uint64_t TEXTURE_VRAM_BUDGET = 64 * 1024 * 1024;
+const uint64_t TEXTURE_STAGING_RING_SIZE = 16 * 1024 * 1024;
+const uint64_t TEXTURE_UPLOAD_BYTES_PER_FRAME = 4 * 1024 * 1024;
+// mips this size and smaller are uploaded at startup, the rest is streamed in
+const uint32_t TEXTURE_MIP_TAIL_SIZE = 64;
+// transfer source so drop_texture_mip() can copy the resident mips into a smaller image
+const vk::ImageUsageFlags TEXTURE_USAGE =
+    vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
+
+// heap usage is sampled every MEMORY_BUDGET_CHECK_FRAMES frames, above MEMORY_BUDGET_HIGH_WATER of a heap's budget
+// memory is released in priority order. The budget comes from VK_EXT_memory_budget, without it a fraction of the
+// heap size is assumed. LEARN_VULKAN_MEMORY_BUDGET_MB=<n> caps every heap's budget to exercise eviction.
+const uint32_t MEMORY_BUDGET_CHECK_FRAMES = 60;
+const float MEMORY_BUDGET_HIGH_WATER = 0.9f;
+const float MEMORY_BUDGET_HEAP_FRACTION = 0.8f;
+
+// VK_EXT_memory_priority hints, the driver moves low priority allocations out first when a heap is oversubscribed
+const float MEMORY_PRIORITY_FRAME = 1.0f; // touched every frame: render targets and uniforms
+const float MEMORY_PRIORITY_GEOMETRY = 0.75f;
+const float MEMORY_PRIORITY_DEFAULT = 0.5f;
+const float MEMORY_PRIORITY_STAGING = 0.1f;
+
 struct QueueFamilyIndices
 {
     std::optional<uint32_t> graphics_family;
     std::optional<uint32_t> present_family;
+    std::optional<uint32_t> compute_family; // a family without graphics if there is one
 
     bool is_complete()
     {
-        return graphics_family.has_value() && present_family.has_value();
+        return graphics_family.has_value() && present_family.has_value() && compute_family.has_value();
     }
 };
 
+struct TextureFormatCandidate
+{
+    vk::Format format;
+    const char *suffix;
+};
+
+struct StreamedTexture
+{
+    Ktx2Info info;
+    vk::Format format;
+    vk::Image image;
+    vk::DeviceMemory memory;
+    vk::ImageView view;
+    uint32_t first_level;  // file level stored in image mip 0, anything above does not fit the budget
+    uint32_t mip_count;    // image mips
+    uint32_t resident_mip; // most detailed image mip that has been uploaded and is visible through view
+};
+
+struct TextureUpload
+{
+    uint32_t mip;
+    StagingRing::Allocation allocation;
+};
+
 struct SwapChainSupportDetails
 {
     vk::SurfaceCapabilitiesKHR capabilities;
@@ -37,6 +148,61 @@ struct SwapChainSupportDetails
     std::vector<vk::PresentModeKHR> present_modes;
 };
 
+// one window with its own swapchain, every target shares the render pass and pipelines
+struct WindowTarget
+{
+    GLFWwindow *window;
+    vk::SurfaceKHR surface;
+
+    vk::SwapchainKHR swapchain;
+    vk::Extent2D extent;
+    std::vector<vk::Image> images;
+
+    // sized for the maximum render scale, the current scale renders into its top left corner and is blitted
+    // to the swapchain image
+    vk::Image render_image;
+    vk::DeviceMemory render_memory;
+    vk::ImageView render_view;
+    vk::Image depth_image; // same size, only needed while the render pass runs
+    vk::DeviceMemory depth_memory;
+    vk::ImageView depth_view;
+    vk::Framebuffer framebuffer;
+
+    vk::CommandBuffer command_buffer;
+    vk::Semaphore sem_image_available;
+    vk::Semaphore sem_render_finished;
+    uint32_t image_index; // acquired for the current frame
+};
+
+static uint64_t elapsed_us(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+}
+
+static vk::Extent2D scaled_extent(vk::Extent2D extent, float scale)
+{
+    uint32_t width = (uint32_t)(extent.width * scale);
+    uint32_t height = (uint32_t)(extent.height * scale);
+    return vk::Extent2D{std::max(width, 1u), std::max(height, 1u)};
+}
+
+// column major, out = a * b
+static void multiply_matrices(const float a[16], const float b[16], float out[16])
+{
+    for (int col = 0; col < 4; col++)
+    {
+        for (int row = 0; row < 4; row++)
+        {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; k++)
+            {
+                sum += a[k * 4 + row] * b[col * 4 + k];
+            }
+            out[col * 4 + row] = sum;
+        }
+    }
+}
+
 static std::vector<uint8_t> read_file(const std::string &filename)
 {
     std::ifstream f(filename, std::ios::ate | std::ios::binary);
@@ -56,6 +222,56 @@ static std::vector<uint8_t> read_file(const std::string &filename)
     return buffer;
 }
 
+// the original triangle, tessellated so the mesh optimizer has something to work with
+static void generate_triangle_mesh(uint32_t subdivisions, std::vector<MeshVertex> &vertices,
+                                   std::vector<uint32_t> &indices)
+{
+    const float corners[3][2] = {{0.0f, -0.5f}, {0.5f, 0.5f}, {-0.5f, 0.5f}};
+    const float colors[3][3] = {{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}};
+
+    // row i holds i + 1 vertices, barycentric weights w1 = (i - j) / n and w2 = j / n
+    auto vertex_index = [](uint32_t i, uint32_t j) { return i * (i + 1) / 2 + j; };
+
+    vertices.clear();
+    for (uint32_t i = 0; i <= subdivisions; i++)
+    {
+        for (uint32_t j = 0; j <= i; j++)
+        {
+            float w1 = float(i - j) / float(subdivisions);
+            float w2 = float(j) / float(subdivisions);
+            float w[3] = {1.0f - w1 - w2, w1, w2};
+
+            MeshVertex vertex{};
+            for (int c = 0; c < 3; c++)
+            {
+                vertex.position[0] += w[c] * corners[c][0];
+                vertex.position[1] += w[c] * corners[c][1];
+                vertex.color[0] += w[c] * colors[c][0];
+                vertex.color[1] += w[c] * colors[c][1];
+                vertex.color[2] += w[c] * colors[c][2];
+            }
+            vertex.normal[2] = 1.0f;
+            vertex.color[3] = 1.0f;
+            vertices.push_back(vertex);
+        }
+    }
+
+    // clockwise, matching the rasterizer front face
+    indices.clear();
+    for (uint32_t i = 0; i < subdivisions; i++)
+    {
+        for (uint32_t j = 0; j <= i; j++)
+        {
+            indices.insert(indices.end(), {vertex_index(i, j), vertex_index(i + 1, j), vertex_index(i + 1, j + 1)});
+            if (j < i)
+            {
+                indices.insert(indices.end(),
+                               {vertex_index(i, j), vertex_index(i + 1, j + 1), vertex_index(i, j + 1)});
+            }
+        }
+    }
+}
+
 class LearnVulkanApp
 {
   public:
@@ -68,51 +284,158 @@ class LearnVulkanApp
     }
 
   private:
-    GLFWwindow *window;
+    std::vector<WindowTarget> windows;
     vk::Instance instance;
 
     std::vector<vk::ExtensionProperties> supported_extensions;
+    std::vector<vk::ExtensionProperties> supported_device_extensions;
     std::vector<vk::LayerProperties> supported_layers;
 
     vk::PhysicalDevice physical_device;
-    vk::SurfaceKHR surface;
 
     vk::Device device;
+    vk::PhysicalDeviceFeatures enabled_features;
     vk::Queue graphics_queue;
     vk::Queue present_queue;
+    vk::Queue compute_queue; // may be graphics_queue
+    bool compute_queue_dedicated = false;
 
-    vk::SwapchainKHR swapchain;
-    vk::Format swapchain_image_format;
-    vk::Extent2D swapchain_extent;
-    std::vector<vk::Image> swapchain_images;
-    std::vector<vk::ImageView> swapchain_image_views;
+    vk::Format swapchain_image_format; // the same for every window so they can share the render pass
+    vk::Format depth_format;
+    vk::Filter upscale_filter = vk::Filter::eLinear;
 
     vk::RenderPass render_pass;
+    vk::DescriptorSetLayout descriptor_set_layout;
+    vk::DescriptorSetLayout uniform_set_layout;
     vk::PipelineLayout pipeline_layout;
-    vk::Pipeline graphics_pipeline;
+    vk::Pipeline graphics_pipeline; // fallback while pipeline variants compile
+
+    ShaderProgram shader_program;
+    PipelineManager pipeline_manager;
+    std::vector<PipelineKey> pipeline_variants;
+    size_t active_pipeline_variant = 0;
 
-    std::vector<vk::Framebuffer> swapchain_framebuffers;
     vk::CommandPool command_pool;
-    vk::CommandBuffer command_buffer;
 
-    vk::Semaphore sem_image_available;
-    vk::Semaphore sem_render_finished;
+    vk::Buffer vertex_buffer;
+    vk::DeviceMemory vertex_buffer_memory;
+    vk::Buffer index_buffer;
+    vk::DeviceMemory index_buffer_memory;
+    uint32_t index_count = 0;
+    float mesh_center[3] = {};
+    float mesh_radius = 0.0f;
+    float view_projection[16] = {}; // column major
+
+    Simulation simulation;
+    FrustumCuller culler;
+    std::vector<uint32_t> visible_instances; // ascending
+    DrawList draw_list;
+    DrawStats draw_stats; // every window of the current frame
+    uint32_t current_frame = 0; // cycles through MAX_FRAMES_IN_FLIGHT
+
+    // DrawUniforms of every draw, written once per frame and shared by all windows
+    UniformRing uniform_ring;
+    vk::Buffer uniform_buffer;
+    vk::DeviceMemory uniform_buffer_memory;
+    vk::DescriptorSet uniform_set;
+
+    vk::DescriptorPool descriptor_pool;
+    vk::DescriptorSet descriptor_set;
+    std::vector<vk::DescriptorSet> materials; // indexed by the material of a draw key
+    vk::Sampler texture_sampler;
+    StreamedTexture texture{};
+
+    StagingRing staging_ring;
+    vk::Buffer staging_ring_buffer;
+    vk::DeviceMemory staging_ring_memory;
+    uint8_t *staging_ring_data = nullptr;
+    std::thread texture_stream_thread;
+    std::mutex texture_stream_mutex;
+    std::vector<TextureUpload> texture_uploads_ready;    // read into the ring by the stream thread
+    std::vector<TextureUpload> texture_uploads_recorded; // copies recorded, waiting for the frame to finish
+
+    ResolutionScaler resolution_scaler;
+    bool timestamps_supported = false;
+    bool timestamps_pending = false; // written by the frame the fence guards
+    float timestamp_period = 1.0f;
+    vk::QueryPool timestamp_query_pool;
+
+    CaptureWriter capture;
+    uint32_t capture_frame_limit = 0;
+
+    RenderMetrics metrics;
+    MetricsServer metrics_server;
+    std::chrono::steady_clock::time_point last_frame_start;
+
+    struct DeviceAllocation
+    {
+        uint32_t heap;
+        vk::DeviceSize size;
+    };
+    std::unordered_map<VkDeviceMemory, DeviceAllocation> device_allocations;
+
+    bool memory_budget_supported = false;
+    bool memory_priority_enabled = false;
+    PFN_vkGetPhysicalDeviceMemoryProperties2KHR get_memory_properties2 = nullptr;
+    vk::DeviceSize memory_budget_cap = 0; // 0 if not capped
+    uint32_t frames_until_budget_check = 0;
+    bool eviction_exhausted[VK_MAX_MEMORY_HEAPS] = {}; // logged once until the heap drops below the high-water mark
+
+    // Step k of particles.comp reads buffer (k + 1) % 2 and writes buffer k % 2 on the compute queue while frame k
+    // draws buffer (k + 1) % 2, written by step k - 1, so simulating the next frame overlaps drawing this one.
+    // Across queues, particles_simulated[k % 2] orders the draw of frame k + 1 after step k and particles_drawn[k % 2]
+    // orders step k + 1 after the draw of frame k, which read the buffer it overwrites. Consecutive steps are ordered
+    // by a barrier at the top of each compute command buffer, the semaphores do not cover them.
+    uint32_t particle_count = 0; // 0 if disabled
+    uint64_t particle_step = 0;
+    vk::DescriptorSetLayout particle_set_layout;
+    vk::PipelineLayout particle_sim_layout;
+    vk::Pipeline particle_sim_pipeline;
+    vk::PipelineLayout particle_draw_layout;
+    vk::Pipeline particle_draw_pipeline;
+    vk::Buffer particle_buffers[2];
+    vk::DeviceMemory particle_buffer_memory[2];
+    vk::DescriptorPool particle_descriptor_pool;
+    vk::DescriptorSet particle_sets[2]; // set i writes buffer i
+    vk::CommandPool compute_command_pool;
+    vk::CommandBuffer compute_command_buffers[2];
+    vk::Semaphore sem_particles_simulated[2];
+    vk::Semaphore sem_particles_drawn[2];
+    bool particle_timestamps_supported = false;
+    vk::QueryPool particle_query_pool; // a begin and end query per step parity
+
     vk::Fence fence_in_flight;
 
     void init_vulkan()
     {
         create_instance();
-        create_surface();
+        create_surfaces();
         pick_physical_device();
         create_logical_device();
-        create_swap_chain();
-        create_image_views();
+        init_memory_budget();
+        create_swap_chains();
         create_render_pass();
         create_graphics_pipeline();
-        create_framebuffers();
+        create_compute_pipeline();
+        init_resolution_scale();
+        create_render_targets();
         create_command_pool();
-        create_command_buffer();
+        start_capture();
+        load_mesh();
+        create_scene();
+        create_texture();
+        create_texture_sampler();
+        create_uniform_ring();
+        create_descriptor_pool();
+        create_descriptor_set();
+        create_particle_buffers();
+        create_command_buffers();
         create_sync_objects();
+        create_timestamp_queries();
+        create_particle_queries();
+        start_texture_streaming();
+        start_metrics_server();
+        start_simulation();
     }
 
     QueueFamilyIndices find_queue_families(vk::PhysicalDevice device)
@@ -120,6 +443,7 @@ class LearnVulkanApp
         QueueFamilyIndices indices;
         std::vector<vk::QueueFamilyProperties> queueFamilies = device.getQueueFamilyProperties();
 
+        bool compute_dedicated = false;
         int i = 0;
         for (const auto &queueFamily : queueFamilies)
         {
@@ -128,15 +452,33 @@ class LearnVulkanApp
                 indices.graphics_family = i;
             }
 
-            auto res = device.getSurfaceSupportKHR(i, surface);
-            if (res.result == vk::Result::eSuccess && res.value)
+            // a family without graphics usually maps to separate hardware queues that run alongside rendering
+            if (queueFamily.queueFlags & vk::QueueFlagBits::eCompute)
             {
-                indices.present_family = i;
+                bool dedicated = !(queueFamily.queueFlags & vk::QueueFlagBits::eGraphics);
+                if (!indices.compute_family.has_value() || (dedicated && !compute_dedicated))
+                {
+                    indices.compute_family = i;
+                    compute_dedicated = dedicated;
+                }
             }
-            else if (res.result != vk::Result::eSuccess)
+
+            // a single present call needs one queue that can present to every window
+            bool presents_all = true;
+            for (const auto &target : windows)
             {
-                std::cerr << "failed to get surface support" << std::endl;
-                exit(EXIT_FAILURE);
+                auto res = device.getSurfaceSupportKHR(i, target.surface);
+                if (res.result != vk::Result::eSuccess)
+                {
+                    std::cerr << "failed to get surface support" << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                presents_all = presents_all && res.value;
+            }
+
+            if (presents_all)
+            {
+                indices.present_family = i;
             }
 
             i++;
@@ -145,7 +487,7 @@ class LearnVulkanApp
         return indices;
     }
 
-    SwapChainSupportDetails query_swap_chain_support(vk::PhysicalDevice device)
+    SwapChainSupportDetails query_swap_chain_support(vk::PhysicalDevice device, vk::SurfaceKHR surface)
     {
         SwapChainSupportDetails details;
         auto capabilities = device.getSurfaceCapabilitiesKHR(surface);
@@ -204,6 +546,15 @@ class LearnVulkanApp
         std::cerr << "GLFW error: " << description << std::endl;
     }
 
+    static void glfw_key_cb(GLFWwindow *window, int key, int scancode, int action, int mods)
+    {
+        auto app = (LearnVulkanApp *)glfwGetWindowUserPointer(window);
+        if (key == GLFW_KEY_V && action == GLFW_PRESS)
+        {
+            app->active_pipeline_variant = (app->active_pipeline_variant + 1) % app->pipeline_variants.size();
+        }
+    }
+
     void init_window()
     {
         glfwInit();
@@ -213,11 +564,29 @@ class LearnVulkanApp
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
         glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 
-        window = glfwCreateWindow(800, 600, "Learn Vulkan", nullptr, nullptr);
-        if (window == nullptr)
+        const char *window_count_env = getenv("LEARN_VULKAN_WINDOWS");
+        uint32_t window_count = window_count_env != nullptr ? (uint32_t)atoi(window_count_env) : 1;
+        window_count = std::clamp(window_count, 1u, MAX_WINDOWS);
+
+        windows.resize(window_count);
+        for (uint32_t i = 0; i < window_count; i++)
         {
-            std::cerr << "failed to create window" << std::endl;
-            exit(EXIT_FAILURE);
+            std::string title = "Learn Vulkan";
+            if (window_count > 1)
+            {
+                title += " " + std::to_string(i);
+            }
+
+            GLFWwindow *window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, title.c_str(), nullptr, nullptr);
+            if (window == nullptr)
+            {
+                std::cerr << "failed to create window" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+
+            glfwSetWindowUserPointer(window, this);
+            glfwSetKeyCallback(window, glfw_key_cb);
+            windows[i].window = window;
         }
     }
 
@@ -307,10 +676,14 @@ class LearnVulkanApp
     bool is_device_suitable(VkPhysicalDevice device)
     {
         QueueFamilyIndices indices = find_queue_families(device);
-        SwapChainSupportDetails swap_chain_support = query_swap_chain_support(device);
 
-        const bool swap_chain_adequate =
-            !swap_chain_support.formats.empty() && !swap_chain_support.present_modes.empty();
+        bool swap_chain_adequate = true;
+        for (const auto &target : windows)
+        {
+            SwapChainSupportDetails swap_chain_support = query_swap_chain_support(device, target.surface);
+            swap_chain_adequate = swap_chain_adequate && !swap_chain_support.formats.empty() &&
+                                  !swap_chain_support.present_modes.empty();
+        }
 
         return indices.is_complete() && swap_chain_adequate;
     }
@@ -360,20 +733,70 @@ class LearnVulkanApp
             exit(EXIT_FAILURE);
         }
 
+        float queuePriority = 1.0f;
+        std::vector<vk::DeviceQueueCreateInfo> queue_create_infos;
+
         vk::DeviceQueueCreateInfo queue_create_info{};
         queue_create_info.queueFamilyIndex = indices.graphics_family.value();
         queue_create_info.queueCount = 1;
-        float queuePriority = 1.0f;
         queue_create_info.pQueuePriorities = &queuePriority;
+        queue_create_infos.push_back(queue_create_info);
 
+        compute_queue_dedicated = indices.compute_family != indices.graphics_family;
+        if (compute_queue_dedicated)
+        {
+            queue_create_info.queueFamilyIndex = indices.compute_family.value();
+            queue_create_infos.push_back(queue_create_info);
+        }
+
+        // block compressed formats need their feature enabled before getFormatProperties support can be used
+        vk::PhysicalDeviceFeatures supported_features = physical_device.getFeatures();
         vk::PhysicalDeviceFeatures device_features{};
+        device_features.textureCompressionBC = supported_features.textureCompressionBC;
+        device_features.textureCompressionETC2 = supported_features.textureCompressionETC2;
+        device_features.fillModeNonSolid = supported_features.fillModeNonSolid;
+        enabled_features = device_features;
 
         std::vector<const char *> device_extensions = {"VK_KHR_portability_subset", VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 
+        auto supported_res = physical_device.enumerateDeviceExtensionProperties();
+        if (supported_res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to enumerate device extensions" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        supported_device_extensions = supported_res.value;
+
+        // both optional, without them the budget is estimated and allocations carry no priority
+        memory_budget_supported = device_extension_supported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        if (memory_budget_supported)
+        {
+            device_extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+            get_memory_properties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)vkGetInstanceProcAddr(
+                instance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+            memory_budget_supported = get_memory_properties2 != nullptr;
+        }
+
+        vk::PhysicalDeviceMemoryPriorityFeaturesEXT priority_features{};
+        memory_priority_enabled =
+            device_extension_supported(VK_EXT_MEMORY_PRIORITY_EXTENSION_NAME) && memory_priority_supported();
+        if (memory_priority_enabled)
+        {
+            device_extensions.push_back(VK_EXT_MEMORY_PRIORITY_EXTENSION_NAME);
+            priority_features.memoryPriority = VK_TRUE;
+        }
+
+        std::cerr << "memory budget: " << (memory_budget_supported ? "VK_EXT_memory_budget" : "estimated")
+                  << ", priorities " << (memory_priority_enabled ? "enabled" : "not supported") << std::endl;
+
         vk::DeviceCreateInfo create_info{};
-        create_info.setQueueCreateInfos(queue_create_info);
+        create_info.setQueueCreateInfos(queue_create_infos);
         create_info.pEnabledFeatures = &device_features;
         create_info.setPEnabledExtensionNames(device_extensions);
+        if (memory_priority_enabled)
+        {
+            create_info.pNext = &priority_features;
+        }
 
         if (ENABLE_VALIDATION_LAYERS)
         {
@@ -397,18 +820,53 @@ class LearnVulkanApp
 
         graphics_queue = device.getQueue(indices.graphics_family.value(), 0);
         present_queue = device.getQueue(indices.present_family.value(), 0);
+        compute_queue = device.getQueue(indices.compute_family.value(), 0);
+        std::cerr << "compute queue: family " << indices.compute_family.value()
+                  << (compute_queue_dedicated ? "" : ", shared with graphics") << std::endl;
     }
 
-    void create_surface()
+    bool device_extension_supported(const char *extension_name)
     {
-        VkSurfaceKHR surface;
-        if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS)
+        for (const auto &extension : supported_device_extensions)
         {
-            std::cerr << "failed to create window surface" << std::endl;
-            exit(EXIT_FAILURE);
+            if (strcmp(extension.extensionName, extension_name) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // the feature has to be queried through VK_KHR_get_physical_device_properties2, the instance is 1.0
+    bool memory_priority_supported()
+    {
+        auto get_features2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(
+            instance, "vkGetPhysicalDeviceFeatures2KHR");
+        if (get_features2 == nullptr)
+        {
+            return false;
         }
 
-        this->surface = surface;
+        vk::PhysicalDeviceMemoryPriorityFeaturesEXT priority_features{};
+        vk::PhysicalDeviceFeatures2 features{};
+        features.pNext = &priority_features;
+        get_features2(physical_device, reinterpret_cast<VkPhysicalDeviceFeatures2 *>(&features));
+        return priority_features.memoryPriority == VK_TRUE;
+    }
+
+    void create_surfaces()
+    {
+        for (auto &target : windows)
+        {
+            VkSurfaceKHR surface;
+            if (glfwCreateWindowSurface(instance, target.window, nullptr, &surface) != VK_SUCCESS)
+            {
+                std::cerr << "failed to create window surface" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+
+            target.surface = surface;
+        }
     }
 
     vk::SurfaceFormatKHR choose_swap_surface_format(const std::vector<vk::SurfaceFormatKHR> &available_formats)
@@ -438,7 +896,7 @@ class LearnVulkanApp
         return vk::PresentModeKHR::eFifo;
     }
 
-    VkExtent2D choose_swap_extent(const VkSurfaceCapabilitiesKHR &capabilities)
+    VkExtent2D choose_swap_extent(GLFWwindow *window, const VkSurfaceCapabilitiesKHR &capabilities)
     {
         if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max())
         {
@@ -460,13 +918,45 @@ class LearnVulkanApp
         }
     }
 
-    void create_swap_chain()
+    void create_swap_chains()
+    {
+        for (size_t i = 0; i < windows.size(); i++)
+        {
+            create_swap_chain(windows[i], i == 0);
+        }
+    }
+
+    // the first window picks the format, the others have to support it to share the render pass
+    void create_swap_chain(WindowTarget &target, bool pick_format)
     {
-        SwapChainSupportDetails swap_chain_support = query_swap_chain_support(physical_device);
+        SwapChainSupportDetails swap_chain_support = query_swap_chain_support(physical_device, target.surface);
+
+        vk::SurfaceFormatKHR surface_format;
+        if (pick_format)
+        {
+            surface_format = choose_swap_surface_format(swap_chain_support.formats);
+        }
+        else
+        {
+            auto it = std::find_if(swap_chain_support.formats.begin(), swap_chain_support.formats.end(),
+                                   [&](const vk::SurfaceFormatKHR &f) { return f.format == swapchain_image_format; });
+            if (it == swap_chain_support.formats.end())
+            {
+                std::cerr << "window surfaces do not share a format" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            surface_format = *it;
+        }
+
+        // swapchain images are only written by the upscale blit
+        if (!(swap_chain_support.capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferDst))
+        {
+            std::cerr << "swapchain images cannot be transfer destinations" << std::endl;
+            exit(EXIT_FAILURE);
+        }
 
-        vk::SurfaceFormatKHR surface_format = choose_swap_surface_format(swap_chain_support.formats);
         vk::PresentModeKHR present_mode = choose_swap_present_mode(swap_chain_support.present_modes);
-        vk::Extent2D extent = choose_swap_extent(swap_chain_support.capabilities);
+        vk::Extent2D extent = choose_swap_extent(target.window, swap_chain_support.capabilities);
 
         uint32_t image_count = swap_chain_support.capabilities.minImageCount + 1;
         if (swap_chain_support.capabilities.maxImageCount > 0)
@@ -475,13 +965,13 @@ class LearnVulkanApp
         }
 
         vk::SwapchainCreateInfoKHR create_info{};
-        create_info.surface = surface;
+        create_info.surface = target.surface;
         create_info.minImageCount = image_count;
         create_info.imageFormat = surface_format.format;
         create_info.imageColorSpace = surface_format.colorSpace;
         create_info.imageExtent = extent;
         create_info.imageArrayLayers = 1;
-        create_info.imageUsage = vk::ImageUsageFlagBits::eColorAttachment;
+        create_info.imageUsage = vk::ImageUsageFlagBits::eTransferDst;
         create_info.imageSharingMode = vk::SharingMode::eExclusive;
         create_info.preTransform = swap_chain_support.capabilities.currentTransform;
         create_info.compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque;
@@ -495,50 +985,18 @@ class LearnVulkanApp
             std::cerr << "failed to create swap chain" << std::endl;
             exit(EXIT_FAILURE);
         }
-        swapchain = res.value;
+        target.swapchain = res.value;
 
-        auto swapchain_images_res = device.getSwapchainImagesKHR(swapchain);
+        auto swapchain_images_res = device.getSwapchainImagesKHR(target.swapchain);
         if (swapchain_images_res.result != vk::Result::eSuccess)
         {
             std::cerr << "failed to get swapchain images" << std::endl;
             exit(EXIT_FAILURE);
         }
-        swapchain_images = swapchain_images_res.value;
+        target.images = swapchain_images_res.value;
 
         swapchain_image_format = surface_format.format;
-        swapchain_extent = extent;
-    }
-
-    void create_image_views()
-    {
-        swapchain_image_views.resize(swapchain_images.size());
-        for (size_t i = 0; i < swapchain_images.size(); i++)
-        {
-            vk::ImageViewCreateInfo create_info{};
-            create_info.image = swapchain_images[i];
-            create_info.viewType = vk::ImageViewType::e2D;
-            create_info.format = swapchain_image_format;
-
-            create_info.components.r = vk::ComponentSwizzle::eIdentity;
-            create_info.components.g = vk::ComponentSwizzle::eIdentity;
-            create_info.components.b = vk::ComponentSwizzle::eIdentity;
-            create_info.components.a = vk::ComponentSwizzle::eIdentity;
-
-            create_info.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
-            create_info.subresourceRange.baseMipLevel = 0;
-            create_info.subresourceRange.levelCount = 1;
-            create_info.subresourceRange.baseArrayLayer = 0;
-            create_info.subresourceRange.layerCount = 1;
-
-            auto res = device.createImageView(create_info);
-            if (res.result != vk::Result::eSuccess)
-            {
-                std::cerr << "failed to create image views" << std::endl;
-                exit(EXIT_FAILURE);
-            }
-
-            swapchain_image_views[i] = res.value;
-        }
+        target.extent = extent;
     }
 
     vk::ShaderModule create_shader_module(const std::vector<uint8_t> &code)
@@ -565,7 +1023,15 @@ class LearnVulkanApp
 
     void create_render_pass()
     {
-        vk::AttachmentDescription color_attachment{};
+        depth_format = find_depth_format(physical_device);
+        if (depth_format == vk::Format::eUndefined)
+        {
+            std::cerr << "failed to find a depth format" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        vk::AttachmentDescription attachments[2]{};
+        vk::AttachmentDescription &color_attachment = attachments[0];
         color_attachment.format = swapchain_image_format;
         color_attachment.samples = vk::SampleCountFlagBits::e1;
         color_attachment.loadOp = vk::AttachmentLoadOp::eClear;
@@ -573,28 +1039,57 @@ class LearnVulkanApp
         color_attachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
         color_attachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
         color_attachment.initialLayout = vk::ImageLayout::eUndefined;
-        color_attachment.finalLayout = vk::ImageLayout::ePresentSrcKHR;
+        color_attachment.finalLayout = vk::ImageLayout::eTransferSrcOptimal;
+
+        // cleared every frame and never read after the pass
+        vk::AttachmentDescription &depth_attachment = attachments[1];
+        depth_attachment.format = depth_format;
+        depth_attachment.samples = vk::SampleCountFlagBits::e1;
+        depth_attachment.loadOp = vk::AttachmentLoadOp::eClear;
+        depth_attachment.storeOp = vk::AttachmentStoreOp::eDontCare;
+        depth_attachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
+        depth_attachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+        depth_attachment.initialLayout = vk::ImageLayout::eUndefined;
+        depth_attachment.finalLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
 
         vk::AttachmentReference color_attachment_ref{};
         color_attachment_ref.attachment = 0;
         color_attachment_ref.layout = vk::ImageLayout::eColorAttachmentOptimal;
 
+        vk::AttachmentReference depth_attachment_ref{};
+        depth_attachment_ref.attachment = 1;
+        depth_attachment_ref.layout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+
         vk::SubpassDescription subpass{};
         subpass.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
         subpass.setColorAttachments(color_attachment_ref);
-
-        vk::SubpassDependency dependency{};
-        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-        dependency.dstSubpass = 0;
-        dependency.srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
-        dependency.srcAccessMask = vk::AccessFlagBits::eNoneKHR;
-        dependency.dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
-        dependency.dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+        subpass.pDepthStencilAttachment = &depth_attachment_ref;
+
+        // the render target is read by the previous frame's blit and the next blit reads what this pass wrote, the
+        // depth clear waits for the previous frame's depth tests
+        vk::SubpassDependency dependencies[2]{};
+        dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[0].dstSubpass = 0;
+        dependencies[0].srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput |
+                                       vk::PipelineStageFlagBits::eTransfer |
+                                       vk::PipelineStageFlagBits::eLateFragmentTests;
+        dependencies[0].srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+        dependencies[0].dstStageMask =
+            vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests;
+        dependencies[0].dstAccessMask =
+            vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+
+        dependencies[1].srcSubpass = 0;
+        dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[1].srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+        dependencies[1].srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+        dependencies[1].dstStageMask = vk::PipelineStageFlagBits::eTransfer;
+        dependencies[1].dstAccessMask = vk::AccessFlagBits::eTransferRead;
 
         vk::RenderPassCreateInfo render_pass_info{};
-        render_pass_info.setAttachments(color_attachment);
+        render_pass_info.setAttachments(attachments);
         render_pass_info.setSubpasses(subpass);
-        render_pass_info.setDependencies(dependency);
+        render_pass_info.setDependencies(dependencies);
 
         auto res = device.createRenderPass(render_pass_info);
         if (res.result != vk::Result::eSuccess)
@@ -607,149 +1102,193 @@ class LearnVulkanApp
 
     void create_graphics_pipeline()
     {
-        std::vector<uint8_t> vert_code = read_file("shaders/tri.vert.spv");
-        std::vector<uint8_t> frag_code = read_file("shaders/tri.frag.spv");
+        std::vector<uint8_t> vert_code = read_file(VERT_SHADER_PATH);
+        std::vector<uint8_t> frag_code = read_file(FRAG_SHADER_PATH);
+
+        // kept alive for background compiles of pipeline variants
+        shader_program.vert_module = create_shader_module(vert_code);
+        shader_program.frag_module = create_shader_module(frag_code);
+        shader_program.hash =
+            hash_bytes(frag_code.data(), frag_code.size(), hash_bytes(vert_code.data(), vert_code.size()));
+
+        descriptor_set_layout = create_descriptor_set_layout(device);
+        uniform_set_layout = create_uniform_set_layout(device);
+        pipeline_layout = create_pipeline_layout(device, descriptor_set_layout, uniform_set_layout);
+
+        uint32_t compile_threads = std::max(std::thread::hardware_concurrency() / 2, 1u);
+        pipeline_manager.init(device, render_pass, pipeline_layout, PIPELINE_CACHE_PATH, compile_threads);
+
+        // the default variant doubles as the fallback while other variants compile
+        PipelineKey default_key{};
+        graphics_pipeline = pipeline_manager.compile(shader_program, default_key);
+        if (!graphics_pipeline)
+        {
+            std::cerr << "failed to create graphics pipeline" << std::endl;
+            exit(EXIT_FAILURE);
+        }
 
-        vk::ShaderModule vert_module = create_shader_module(vert_code);
-        vk::ShaderModule frag_module = create_shader_module(frag_code);
+        // cycled through with the V key, compiled on first use
+        pipeline_variants.push_back(default_key);
 
-        vk::PipelineShaderStageCreateInfo vert_stage_info{};
-        vert_stage_info.stage = vk::ShaderStageFlagBits::eVertex;
-        vert_stage_info.module = vert_module;
-        vert_stage_info.pName = "main";
+        PipelineKey desaturated_key{};
+        desaturated_key.frag_specialization.desaturate = 1;
+        pipeline_variants.push_back(desaturated_key);
 
-        vk::PipelineShaderStageCreateInfo frag_stage_info{};
-        frag_stage_info.stage = vk::ShaderStageFlagBits::eFragment;
-        frag_stage_info.module = frag_module;
-        frag_stage_info.pName = "main";
+        PipelineKey untextured_key{};
+        untextured_key.frag_specialization.use_texture = 0;
+        untextured_key.cull_mode = vk::CullModeFlagBits::eNone;
+        pipeline_variants.push_back(untextured_key);
+
+        if (enabled_features.fillModeNonSolid)
+        {
+            PipelineKey wireframe_key{};
+            wireframe_key.polygon_mode = vk::PolygonMode::eLine;
+            wireframe_key.frag_specialization.use_texture = 0;
+            pipeline_variants.push_back(wireframe_key);
+        }
+    }
 
-        vk::PipelineShaderStageCreateInfo shader_stages[] = {vert_stage_info, frag_stage_info};
+    // separate from the graphics pipeline variants, particles have their own layouts and are never recompiled
+    void create_compute_pipeline()
+    {
+        const char *count_env = getenv("LEARN_VULKAN_PARTICLES");
+        uint64_t count = count_env != nullptr ? strtoull(count_env, nullptr, 10) : PARTICLE_DEFAULT_COUNT;
+
+        // one invocation per particle and the whole state in a single storage buffer binding
+        vk::PhysicalDeviceLimits limits = physical_device.getProperties().limits;
+        uint64_t max_count = std::min((uint64_t)limits.maxComputeWorkGroupCount[0] * PARTICLE_WORKGROUP_SIZE,
+                                      (uint64_t)limits.maxStorageBufferRange / sizeof(Particle));
+        if (count > max_count)
+        {
+            std::cerr << "particles: " << count << " exceeds the device limit, using " << max_count << std::endl;
+            count = max_count;
+        }
+        particle_count = (uint32_t)count;
+        metrics.particles.set(particle_count);
+        if (particle_count == 0)
+        {
+            return;
+        }
 
-        vk::DynamicState dynamic_states[] = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
-        vk::PipelineDynamicStateCreateInfo dynamic_state{};
-        dynamic_state.setDynamicStates(dynamic_states);
+        vk::ShaderModule comp_module = create_shader_module(read_file(PARTICLE_COMP_SHADER_PATH));
+        vk::ShaderModule vert_module = create_shader_module(read_file(PARTICLE_VERT_SHADER_PATH));
+        vk::ShaderModule frag_module = create_shader_module(read_file(PARTICLE_FRAG_SHADER_PATH));
 
-        vk::PipelineVertexInputStateCreateInfo vertex_input_info{};
-        vertex_input_info.vertexBindingDescriptionCount = 0;
-        vertex_input_info.pVertexBindingDescriptions = nullptr;
-        vertex_input_info.vertexAttributeDescriptionCount = 0;
-        vertex_input_info.pVertexAttributeDescriptions = nullptr;
+        particle_set_layout = create_particle_set_layout(device);
+        particle_sim_layout = create_particle_sim_layout(device, particle_set_layout);
+        particle_sim_pipeline = create_particle_sim_pipeline(device, particle_sim_layout, comp_module);
 
-        vk::PipelineInputAssemblyStateCreateInfo input_assembly{};
-        input_assembly.topology = vk::PrimitiveTopology::eTriangleList;
-        input_assembly.primitiveRestartEnable = VK_FALSE;
+        particle_draw_layout = create_particle_draw_layout(device);
+        particle_draw_pipeline =
+            create_particle_draw_pipeline(device, render_pass, particle_draw_layout, vert_module, frag_module);
 
-        vk::Viewport viewport{};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = (float)swapchain_extent.width;
-        viewport.height = (float)swapchain_extent.height;
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
+        device.destroyShaderModule(comp_module);
+        device.destroyShaderModule(vert_module);
+        device.destroyShaderModule(frag_module);
+    }
 
-        vk::Rect2D scissor{};
-        scissor.offset = vk::Offset2D{0, 0};
-        scissor.extent = swapchain_extent;
-
-        vk::PipelineViewportStateCreateInfo viewport_state{};
-        viewport_state.setViewports(viewport);
-        viewport_state.setScissors(scissor);
-
-        vk::PipelineRasterizationStateCreateInfo rasterizer{};
-        rasterizer.depthClampEnable = VK_FALSE;
-        rasterizer.rasterizerDiscardEnable = VK_FALSE;
-        rasterizer.polygonMode = vk::PolygonMode::eFill;
-        rasterizer.lineWidth = 1.0f;
-        rasterizer.cullMode = vk::CullModeFlagBits::eBack;
-        rasterizer.frontFace = vk::FrontFace::eClockwise;
-        rasterizer.depthBiasEnable = VK_FALSE;
-        rasterizer.depthBiasConstantFactor = 0.0f;
-        rasterizer.depthBiasClamp = 0.0f;
-        rasterizer.depthBiasSlopeFactor = 0.0f;
-
-        vk::PipelineMultisampleStateCreateInfo multisampling{};
-        multisampling.sampleShadingEnable = VK_FALSE;
-        multisampling.rasterizationSamples = vk::SampleCountFlagBits::e1;
-        multisampling.minSampleShading = 1.0f;
-        multisampling.pSampleMask = nullptr;
-        multisampling.alphaToCoverageEnable = VK_FALSE;
-        multisampling.alphaToOneEnable = VK_FALSE;
-
-        vk::PipelineColorBlendAttachmentState color_blend_attachment{};
-        color_blend_attachment.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
-                                                vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
-        color_blend_attachment.blendEnable = VK_FALSE;
-        color_blend_attachment.srcColorBlendFactor = vk::BlendFactor::eOne;
-        color_blend_attachment.dstColorBlendFactor = vk::BlendFactor::eZero;
-        color_blend_attachment.colorBlendOp = vk::BlendOp::eAdd;
-        color_blend_attachment.srcAlphaBlendFactor = vk::BlendFactor::eOne;
-        color_blend_attachment.dstAlphaBlendFactor = vk::BlendFactor::eZero;
-        color_blend_attachment.alphaBlendOp = vk::BlendOp::eAdd;
-
-        vk::PipelineColorBlendStateCreateInfo color_blending{};
-        color_blending.logicOpEnable = VK_FALSE;
-        color_blending.logicOp = vk::LogicOp::eCopy;
-        color_blending.setAttachments(color_blend_attachment);
-        color_blending.blendConstants[0] = 0.0f;
-        color_blending.blendConstants[1] = 0.0f;
-        color_blending.blendConstants[2] = 0.0f;
-        color_blending.blendConstants[3] = 0.0f;
-
-        vk::PipelineLayoutCreateInfo pipeline_layout_info{};
-        auto pipeline_layout_res = device.createPipelineLayout(pipeline_layout_info);
-        if (pipeline_layout_res.result != vk::Result::eSuccess)
-        {
-            std::cerr << "failed to create pipeline layout" << std::endl;
-            exit(EXIT_FAILURE);
-        }
-        pipeline_layout = pipeline_layout_res.value;
-
-        vk::GraphicsPipelineCreateInfo pipeline_info{};
-        pipeline_info.setStages(shader_stages);
-        pipeline_info.pVertexInputState = &vertex_input_info;
-        pipeline_info.pInputAssemblyState = &input_assembly;
-        pipeline_info.pViewportState = &viewport_state;
-        pipeline_info.pRasterizationState = &rasterizer;
-        pipeline_info.pMultisampleState = &multisampling;
-        pipeline_info.pColorBlendState = &color_blending;
-        pipeline_info.pDepthStencilState = nullptr;
-        pipeline_info.pDynamicState = &dynamic_state;
-        pipeline_info.layout = pipeline_layout;
-        pipeline_info.renderPass = render_pass;
-        pipeline_info.subpass = 0;
-
-        auto res = device.createGraphicsPipeline(nullptr, pipeline_info);
-        if (res.result != vk::Result::eSuccess)
+    void init_resolution_scale()
+    {
+        const char *min_scale = getenv("LEARN_VULKAN_RENDER_SCALE_MIN");
+        const char *max_scale = getenv("LEARN_VULKAN_RENDER_SCALE_MAX");
+        const char *budget = getenv("LEARN_VULKAN_GPU_BUDGET_MS");
+
+        ResolutionScaleConfig config{};
+        config.step = RENDER_SCALE_STEP;
+        config.max_scale = max_scale != nullptr ? (float)atof(max_scale) : RENDER_SCALE_MAX;
+        config.max_scale = std::clamp(config.max_scale, RENDER_SCALE_STEP, 1.0f);
+        config.min_scale = min_scale != nullptr ? (float)atof(min_scale) : RENDER_SCALE_MIN;
+        config.min_scale = std::clamp(config.min_scale, RENDER_SCALE_STEP, config.max_scale);
+        config.gpu_budget_ms = budget != nullptr ? (float)atof(budget) : GPU_BUDGET_MS;
+        resolution_scaler.init(config);
+
+        std::cerr << "render scale: " << config.min_scale << " to " << config.max_scale << ", GPU budget "
+                  << config.gpu_budget_ms << " ms" << std::endl;
+    }
+
+    void create_render_targets()
+    {
+        // the upscale blits from the render target into the swapchain image, both have the swapchain format
+        const vk::FormatFeatureFlags required = vk::FormatFeatureFlagBits::eColorAttachment |
+                                                vk::FormatFeatureFlagBits::eBlitSrc |
+                                                vk::FormatFeatureFlagBits::eBlitDst;
+        vk::FormatProperties format_properties = physical_device.getFormatProperties(swapchain_image_format);
+        if ((format_properties.optimalTilingFeatures & required) != required)
         {
-            std::cerr << "failed to create graphics pipeline" << std::endl;
+            std::cerr << "swapchain format " << vk::to_string(swapchain_image_format) << " cannot be blitted"
+                      << std::endl;
             exit(EXIT_FAILURE);
         }
-        graphics_pipeline = res.value;
 
-        device.destroyShaderModule(vert_module);
-        device.destroyShaderModule(frag_module);
+        upscale_filter = format_properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear
+                             ? vk::Filter::eLinear
+                             : vk::Filter::eNearest;
+
+        for (auto &target : windows)
+        {
+            create_render_target(target);
+        }
     }
 
-    void create_framebuffers()
+    void create_render_target(WindowTarget &target)
     {
-        for (vk::ImageView image_view : swapchain_image_views)
+        // the scaler starts at its maximum
+        vk::Extent2D extent = scaled_extent(target.extent, resolution_scaler.scale());
+
+        create_image(extent.width, extent.height, 1, swapchain_image_format,
+                     vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,
+                     vk::MemoryPropertyFlagBits::eDeviceLocal, target.render_image, target.render_memory,
+                     MEMORY_PRIORITY_FRAME);
+
+        vk::ImageViewCreateInfo view_info{};
+        view_info.image = target.render_image;
+        view_info.viewType = vk::ImageViewType::e2D;
+        view_info.format = swapchain_image_format;
+        view_info.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+        view_info.subresourceRange.baseMipLevel = 0;
+        view_info.subresourceRange.levelCount = 1;
+        view_info.subresourceRange.baseArrayLayer = 0;
+        view_info.subresourceRange.layerCount = 1;
+
+        auto view_res = device.createImageView(view_info);
+        if (view_res.result != vk::Result::eSuccess)
         {
-            vk::FramebufferCreateInfo fb_info{};
-            fb_info.renderPass = render_pass;
-            fb_info.setAttachments(image_view);
-            fb_info.width = swapchain_extent.width;
-            fb_info.height = swapchain_extent.height;
-            fb_info.layers = 1;
+            std::cerr << "failed to create render target view" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        target.render_view = view_res.value;
 
-            auto res = device.createFramebuffer(fb_info);
-            if (res.result != vk::Result::eSuccess)
-            {
-                std::cerr << "failed to create framebuffer" << std::endl;
-                exit(EXIT_FAILURE);
-            }
+        create_image(extent.width, extent.height, 1, depth_format, vk::ImageUsageFlagBits::eDepthStencilAttachment,
+                     vk::MemoryPropertyFlagBits::eDeviceLocal, target.depth_image, target.depth_memory,
+                     MEMORY_PRIORITY_FRAME);
+
+        view_info.image = target.depth_image;
+        view_info.format = depth_format;
+        view_info.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eDepth;
 
-            swapchain_framebuffers.push_back(res.value);
+        auto depth_view_res = device.createImageView(view_info);
+        if (depth_view_res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to create depth view" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        target.depth_view = depth_view_res.value;
+
+        const vk::ImageView attachments[2] = {target.render_view, target.depth_view};
+        vk::FramebufferCreateInfo fb_info{};
+        fb_info.renderPass = render_pass;
+        fb_info.setAttachments(attachments);
+        fb_info.width = extent.width;
+        fb_info.height = extent.height;
+        fb_info.layers = 1;
+
+        auto fb_res = device.createFramebuffer(fb_info);
+        if (fb_res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to create framebuffer" << std::endl;
+            exit(EXIT_FAILURE);
         }
+        target.framebuffer = fb_res.value;
     }
 
     void create_command_pool()
@@ -769,83 +1308,1822 @@ class LearnVulkanApp
         command_pool = res.value;
     }
 
-    void create_command_buffer()
+    uint32_t find_memory_type(uint32_t type_filter, vk::MemoryPropertyFlags properties)
     {
-        vk::CommandBufferAllocateInfo alloc_info{};
-        alloc_info.commandPool = command_pool;
-        alloc_info.level = vk::CommandBufferLevel::ePrimary;
-        alloc_info.commandBufferCount = 1;
-
-        auto res = device.allocateCommandBuffers(alloc_info);
-        if (res.result != vk::Result::eSuccess || res.value.size() != 1)
+        vk::PhysicalDeviceMemoryProperties mem_properties = physical_device.getMemoryProperties();
+        for (uint32_t i = 0; i < mem_properties.memoryTypeCount; i++)
         {
-            std::cerr << "failed to allocate command buffers" << std::endl;
-            exit(EXIT_FAILURE);
+            if ((type_filter & (1 << i)) && (mem_properties.memoryTypes[i].propertyFlags & properties) == properties)
+            {
+                return i;
+            }
         }
-        command_buffer = res.value[0];
+
+        std::cerr << "failed to find suitable memory type" << std::endl;
+        exit(EXIT_FAILURE);
     }
 
-    void record_command_buffer(vk::CommandBuffer command_buffer, uint32_t image_index)
+    // every device allocation goes through here so per-heap usage can be reported
+    vk::DeviceMemory allocate_device_memory(const vk::MemoryAllocateInfo &alloc_info,
+                                            float priority = MEMORY_PRIORITY_DEFAULT)
     {
-        vk::CommandBufferBeginInfo begin_info{};
-        if (command_buffer.begin(begin_info) != vk::Result::eSuccess)
+        vk::MemoryPriorityAllocateInfoEXT priority_info{};
+        priority_info.priority = priority;
+
+        vk::MemoryAllocateInfo info = alloc_info;
+        if (memory_priority_enabled)
         {
-            std::cerr << "failed to begin recording command buffer" << std::endl;
-            exit(EXIT_FAILURE);
+            info.pNext = &priority_info;
         }
 
-        vk::RenderPassBeginInfo render_pass_info{};
-        render_pass_info.renderPass = render_pass;
-        render_pass_info.framebuffer = swapchain_framebuffers[image_index];
-        render_pass_info.renderArea.offset = vk::Offset2D{0, 0};
-        render_pass_info.renderArea.extent = swapchain_extent;
-        vk::ClearValue clear_value({0.0f, 0.0f, 0.0f, 1.0f});
-        render_pass_info.setClearValues(clear_value);
-
-        command_buffer.beginRenderPass(render_pass_info, vk::SubpassContents::eInline);
-        command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, graphics_pipeline);
+        auto res = device.allocateMemory(info);
+        if (res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to allocate device memory: " << vk::to_string(res.result) << std::endl;
+            exit(EXIT_FAILURE);
+        }
 
-        vk::Viewport viewport{};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = (float)swapchain_extent.width;
-        viewport.height = (float)swapchain_extent.height;
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-        command_buffer.setViewport(0, viewport);
+        vk::PhysicalDeviceMemoryProperties mem_properties = physical_device.getMemoryProperties();
+        uint32_t heap = mem_properties.memoryTypes[alloc_info.memoryTypeIndex].heapIndex;
 
-        vk::Rect2D scissor{};
-        scissor.offset = vk::Offset2D{0, 0};
-        scissor.extent = swapchain_extent;
-        command_buffer.setScissor(0, scissor);
+        device_allocations[static_cast<VkDeviceMemory>(res.value)] = {heap, alloc_info.allocationSize};
+        metrics.heap_allocated_bytes[heap].add((int64_t)alloc_info.allocationSize);
 
-        command_buffer.draw(3, 1, 0, 0);
-        command_buffer.endRenderPass();
+        return res.value;
+    }
 
-        if (command_buffer.end() != vk::Result::eSuccess)
+    void free_device_memory(vk::DeviceMemory memory)
+    {
+        auto it = device_allocations.find(static_cast<VkDeviceMemory>(memory));
+        if (it != device_allocations.end())
         {
-            std::cerr << "failed to record command buffer" << std::endl;
-            exit(EXIT_FAILURE);
+            metrics.heap_allocated_bytes[it->second.heap].add(-(int64_t)it->second.size);
+            device_allocations.erase(it);
+        }
+
+        device.freeMemory(memory);
+    }
+
+    void create_buffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties,
+                       vk::Buffer &buffer, vk::DeviceMemory &buffer_memory, float priority = MEMORY_PRIORITY_DEFAULT)
+    {
+        vk::BufferCreateInfo buffer_info{};
+        buffer_info.size = size;
+        buffer_info.usage = usage;
+        buffer_info.sharingMode = vk::SharingMode::eExclusive;
+
+        auto buffer_res = device.createBuffer(buffer_info);
+        if (buffer_res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to create buffer" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        buffer = buffer_res.value;
+
+        vk::MemoryRequirements mem_requirements = device.getBufferMemoryRequirements(buffer);
+
+        vk::MemoryAllocateInfo alloc_info{};
+        alloc_info.allocationSize = mem_requirements.size;
+        alloc_info.memoryTypeIndex = find_memory_type(mem_requirements.memoryTypeBits, properties);
+
+        buffer_memory = allocate_device_memory(alloc_info, priority);
+
+        if (device.bindBufferMemory(buffer, buffer_memory, 0) != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to bind buffer memory" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    vk::CommandBuffer begin_single_time_commands()
+    {
+        vk::CommandBufferAllocateInfo alloc_info{};
+        alloc_info.commandPool = command_pool;
+        alloc_info.level = vk::CommandBufferLevel::ePrimary;
+        alloc_info.commandBufferCount = 1;
+
+        auto res = device.allocateCommandBuffers(alloc_info);
+        if (res.result != vk::Result::eSuccess || res.value.size() != 1)
+        {
+            std::cerr << "failed to allocate command buffers" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        vk::CommandBufferBeginInfo begin_info{};
+        begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+        if (res.value[0].begin(begin_info) != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to begin recording command buffer" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        return res.value[0];
+    }
+
+    void end_single_time_commands(vk::CommandBuffer command_buffer)
+    {
+        if (command_buffer.end() != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to record command buffer" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        vk::SubmitInfo submit_info{};
+        submit_info.setCommandBuffers(command_buffer);
+
+        if (graphics_queue.submit(submit_info, nullptr) != vk::Result::eSuccess ||
+            graphics_queue.waitIdle() != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to submit transfer command buffer" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        device.freeCommandBuffers(command_pool, command_buffer);
+    }
+
+    // uploads through a host visible staging buffer into a device local buffer
+    void create_device_local_buffer(const void *data, vk::DeviceSize size, vk::BufferUsageFlags usage,
+                                    vk::Buffer &buffer, vk::DeviceMemory &buffer_memory,
+                                    float priority = MEMORY_PRIORITY_DEFAULT)
+    {
+        vk::Buffer staging_buffer;
+        vk::DeviceMemory staging_buffer_memory;
+        create_buffer(size, vk::BufferUsageFlagBits::eTransferSrc,
+                      vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                      staging_buffer, staging_buffer_memory, MEMORY_PRIORITY_STAGING);
+
+        auto map_res = device.mapMemory(staging_buffer_memory, 0, size);
+        if (map_res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to map staging buffer memory" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        memcpy(map_res.value, data, (size_t)size);
+        device.unmapMemory(staging_buffer_memory);
+
+        create_buffer(size, usage | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal,
+                      buffer, buffer_memory, priority);
+
+        vk::CommandBuffer command_buffer = begin_single_time_commands();
+        vk::BufferCopy copy_region{};
+        copy_region.size = size;
+        command_buffer.copyBuffer(staging_buffer, buffer, copy_region);
+        end_single_time_commands(command_buffer);
+
+        device.destroyBuffer(staging_buffer);
+        free_device_memory(staging_buffer_memory);
+    }
+
+    void load_mesh()
+    {
+        std::vector<MeshVertex> vertices;
+        std::vector<uint32_t> indices;
+        generate_triangle_mesh(64, vertices, indices);
+
+        compute_bounding_sphere(vertices);
+
+        VertexCacheStats stats_before = analyze_vertex_cache(indices, vertices.size());
+        size_t bytes_before = sizeof(MeshVertex);
+
+        optimize_vertex_cache(indices, vertices.size());
+        optimize_overdraw(indices, vertices);
+        optimize_vertex_fetch(indices, vertices);
+        std::vector<PackedVertex> packed = quantize_vertices(vertices);
+
+        VertexCacheStats stats_after = analyze_vertex_cache(indices, packed.size());
+        size_t bytes_after = sizeof(PackedVertex);
+
+        std::cerr << "mesh: " << packed.size() << " vertices, " << indices.size() / 3 << " triangles" << std::endl;
+        std::cerr << "mesh: ACMR " << stats_before.acmr << " -> " << stats_after.acmr << ", ATVR " << stats_before.atvr
+                  << " -> " << stats_after.atvr << std::endl;
+        std::cerr << "mesh: bytes per vertex " << bytes_before << " -> " << bytes_after << std::endl;
+
+        create_device_local_buffer(packed.data(), sizeof(PackedVertex) * packed.size(),
+                                   vk::BufferUsageFlagBits::eVertexBuffer, vertex_buffer, vertex_buffer_memory,
+                                   MEMORY_PRIORITY_GEOMETRY);
+        create_device_local_buffer(indices.data(), sizeof(uint32_t) * indices.size(),
+                                   vk::BufferUsageFlagBits::eIndexBuffer, index_buffer, index_buffer_memory,
+                                   MEMORY_PRIORITY_GEOMETRY);
+        index_count = (uint32_t)indices.size();
+
+        if (capture.is_open())
+        {
+            capture.register_buffer(vertex_buffer, CAPTURE_BUFFER_VERTEX, packed.data(),
+                                    sizeof(PackedVertex) * packed.size());
+            capture.register_buffer(index_buffer, CAPTURE_BUFFER_INDEX, indices.data(),
+                                    sizeof(uint32_t) * indices.size());
+        }
+    }
+
+    // center of the bounding box, not minimal but good enough for culling
+    void compute_bounding_sphere(const std::vector<MeshVertex> &vertices)
+    {
+        float min[3] = {vertices[0].position[0], vertices[0].position[1], vertices[0].position[2]};
+        float max[3] = {min[0], min[1], min[2]};
+        for (const auto &vertex : vertices)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                min[c] = std::min(min[c], vertex.position[c]);
+                max[c] = std::max(max[c], vertex.position[c]);
+            }
+        }
+
+        for (int c = 0; c < 3; c++)
+        {
+            mesh_center[c] = (min[c] + max[c]) * 0.5f;
+        }
+
+        float radius_sq = 0.0f;
+        for (const auto &vertex : vertices)
+        {
+            float dx = vertex.position[0] - mesh_center[0];
+            float dy = vertex.position[1] - mesh_center[1];
+            float dz = vertex.position[2] - mesh_center[2];
+            radius_sq = std::max(radius_sq, dx * dx + dy * dy + dz * dz);
+        }
+        mesh_radius = std::sqrt(radius_sq);
+    }
+
+    void create_scene()
+    {
+        const char *extra_env = getenv("LEARN_VULKAN_INSTANCES");
+        uint32_t extra = extra_env != nullptr ? (uint32_t)atoi(extra_env) : 0;
+        simulation.init(mesh_center, mesh_radius, extra, SCENE_EXTENT);
+        create_camera();
+        metrics.instances.set((int64_t)simulation.instance_count());
+
+        uint32_t cull_threads = std::max(std::thread::hardware_concurrency() / 2, 1u);
+        culler.init(cull_threads);
+
+        std::cerr << "scene: " << simulation.instance_count() << " instances, culling with "
+                  << cull_kernel_name(culler.kernel()) << " on " << cull_threads << " threads" << std::endl;
+        if (simulation.instance_count() > MAX_DRAWS_PER_FRAME)
+        {
+            std::cerr << "scene: drawing at most " << MAX_DRAWS_PER_FRAME << " visible instances a frame" << std::endl;
+        }
+    }
+
+    // orthographic along z, the mesh keeps its place on screen and depth covers the whole scene extent
+    void create_camera()
+    {
+        const float depth_scale = 0.5f / SCENE_EXTENT;
+        const float camera[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, depth_scale, 0, 0, 0, 0.5f, 1};
+        memcpy(view_projection, camera, sizeof(view_projection));
+    }
+
+    void start_simulation()
+    {
+        const char *hz_env = getenv("LEARN_VULKAN_SIM_HZ");
+        double hz = hz_env != nullptr ? atof(hz_env) : SIM_TICK_HZ;
+        simulation.start(hz > 0.0 ? hz : SIM_TICK_HZ, &metrics);
+    }
+
+    // takes the newest simulation tick, the snapshot stays untouched until the next frame
+    const FrameSnapshot &acquire_snapshot()
+    {
+        if (!simulation.acquire_snapshot())
+        {
+            metrics.stale_snapshots.add();
+        }
+        return simulation.snapshot();
+    }
+
+    void cull_instances(const FrameSnapshot &snapshot)
+    {
+        auto cull_start = std::chrono::steady_clock::now();
+
+        Frustum frustum = frustum_from_matrix(view_projection);
+        culler.cull(frustum, snapshot.instances, visible_instances);
+
+        metrics.cull_us.observe(elapsed_us(cull_start, std::chrono::steady_clock::now()));
+        metrics.visible_instances.set((int64_t)visible_instances.size());
+    }
+
+    // one draw per visible instance, its DrawUniforms go straight into this frame's region of the uniform ring
+    void build_draw_list(const FrameSnapshot &snapshot)
+    {
+        draw_list.clear();
+        uniform_ring.begin_frame(current_frame);
+
+        const InstanceStore &instances = snapshot.instances;
+        for (size_t i = 0; i < visible_instances.size(); i++)
+        {
+            uint32_t instance = visible_instances[i];
+            uint32_t uniform_offset;
+            DrawUniforms *uniforms = (DrawUniforms *)uniform_ring.allocate(sizeof(DrawUniforms), uniform_offset);
+            if (uniforms == nullptr)
+            {
+                // the ring holds MAX_DRAWS_PER_FRAME blocks, the rest of the visible instances are not drawn
+                metrics.draws_capped.add(visible_instances.size() - i);
+                break;
+            }
+
+            // every instance is a copy of the mesh, scaled to its bounding sphere
+            const float center[3] = {instances.center_x_data()[instance], instances.center_y_data()[instance],
+                                     instances.center_z_data()[instance]};
+            const float scale = instances.radius_data()[instance] / mesh_radius;
+            const float model[16] = {scale, 0, 0, 0, 0, scale, 0, 0, 0, 0, scale, 0,
+                                     center[0] - mesh_center[0] * scale, center[1] - mesh_center[1] * scale,
+                                     center[2] - mesh_center[2] * scale, 1};
+            multiply_matrices(view_projection, model, uniforms->model_view_projection);
+            uniforms->time = (float)snapshot.time;
+
+            uint32_t pipeline = (uint32_t)active_pipeline_variant;
+            DrawPass pass = pipeline_variants[pipeline].blend_enable ? DrawPass::Transparent : DrawPass::Opaque;
+            float depth = view_projection[2] * center[0] + view_projection[6] * center[1] +
+                          view_projection[10] * center[2] + view_projection[14];
+
+            DrawItem item{};
+            item.key = make_draw_key(pass, pipeline, 0, depth);
+            item.instance = instance;
+            item.index_count = index_count;
+            item.first_index = 0;
+            item.vertex_offset = 0;
+            item.uniform_offset = uniform_offset;
+            draw_list.add(item);
+        }
+
+        draw_list.sort();
+        metrics.uniform_bytes.set((int64_t)uniform_ring.frame_used());
+    }
+
+    void start_capture()
+    {
+        const char *path = getenv("LEARN_VULKAN_CAPTURE");
+        if (path == nullptr)
+        {
+            return;
+        }
+
+        const char *frames = getenv("LEARN_VULKAN_CAPTURE_FRAMES");
+        capture_frame_limit = frames != nullptr ? (uint32_t)atoi(frames) : CAPTURE_DEFAULT_FRAMES;
+
+        if (!capture.open(path))
+        {
+            std::cerr << "failed to open capture file: " << path << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        // only the first window is captured
+        capture.write_target(swapchain_image_format, windows[0].extent);
+        capture.write_shaders(read_file(VERT_SHADER_PATH), read_file(FRAG_SHADER_PATH));
+
+        std::cerr << "capture: recording " << capture_frame_limit << " frames to " << path << std::endl;
+    }
+
+    void create_image(uint32_t width, uint32_t height, uint32_t mip_levels, vk::Format format,
+                      vk::ImageUsageFlags usage, vk::MemoryPropertyFlags properties, vk::Image &image,
+                      vk::DeviceMemory &image_memory, float priority = MEMORY_PRIORITY_DEFAULT)
+    {
+        vk::ImageCreateInfo image_info{};
+        image_info.imageType = vk::ImageType::e2D;
+        image_info.extent = vk::Extent3D{width, height, 1};
+        image_info.mipLevels = mip_levels;
+        image_info.arrayLayers = 1;
+        image_info.format = format;
+        image_info.tiling = vk::ImageTiling::eOptimal;
+        image_info.initialLayout = vk::ImageLayout::eUndefined;
+        image_info.usage = usage;
+        image_info.samples = vk::SampleCountFlagBits::e1;
+        image_info.sharingMode = vk::SharingMode::eExclusive;
+
+        auto image_res = device.createImage(image_info);
+        if (image_res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to create image" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        image = image_res.value;
+
+        vk::MemoryRequirements mem_requirements = device.getImageMemoryRequirements(image);
+
+        vk::MemoryAllocateInfo alloc_info{};
+        alloc_info.allocationSize = mem_requirements.size;
+        alloc_info.memoryTypeIndex = find_memory_type(mem_requirements.memoryTypeBits, properties);
+
+        image_memory = allocate_device_memory(alloc_info, priority);
+
+        if (device.bindImageMemory(image, image_memory, 0) != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to bind image memory" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    void transition_image_layout(vk::CommandBuffer command_buffer, vk::Image image, uint32_t base_mip,
+                                 uint32_t mip_count, vk::ImageLayout old_layout, vk::ImageLayout new_layout)
+    {
+        vk::ImageMemoryBarrier barrier{};
+        barrier.oldLayout = old_layout;
+        barrier.newLayout = new_layout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+        barrier.subresourceRange.baseMipLevel = base_mip;
+        barrier.subresourceRange.levelCount = mip_count;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+
+        vk::PipelineStageFlags src_stage;
+        vk::PipelineStageFlags dst_stage;
+
+        if (old_layout == vk::ImageLayout::eUndefined && new_layout == vk::ImageLayout::eTransferDstOptimal)
+        {
+            barrier.srcAccessMask = vk::AccessFlagBits::eNoneKHR;
+            barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+            src_stage = vk::PipelineStageFlagBits::eTopOfPipe;
+            dst_stage = vk::PipelineStageFlagBits::eTransfer;
+        }
+        else if (old_layout == vk::ImageLayout::eTransferDstOptimal &&
+                 new_layout == vk::ImageLayout::eShaderReadOnlyOptimal)
+        {
+            barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+            barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+            src_stage = vk::PipelineStageFlagBits::eTransfer;
+            dst_stage = vk::PipelineStageFlagBits::eFragmentShader;
+        }
+        else if (old_layout == vk::ImageLayout::eShaderReadOnlyOptimal &&
+                 new_layout == vk::ImageLayout::eTransferSrcOptimal)
+        {
+            barrier.srcAccessMask = vk::AccessFlagBits::eShaderRead;
+            barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+            src_stage = vk::PipelineStageFlagBits::eFragmentShader;
+            dst_stage = vk::PipelineStageFlagBits::eTransfer;
+        }
+        else
+        {
+            std::cerr << "unsupported layout transition" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        command_buffer.pipelineBarrier(src_stage, dst_stage, vk::DependencyFlags(), nullptr, nullptr, barrier);
+    }
+
+    void record_texture_copy(vk::CommandBuffer command_buffer, vk::Buffer buffer, vk::DeviceSize offset, uint32_t mip)
+    {
+        uint32_t level = texture.first_level + mip;
+
+        vk::BufferImageCopy region{};
+        region.bufferOffset = offset;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+        region.imageSubresource.mipLevel = mip;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = vk::Offset3D{0, 0, 0};
+        region.imageExtent =
+            vk::Extent3D{ktx2_level_width(texture.info, level), ktx2_level_height(texture.info, level), 1};
+
+        transition_image_layout(command_buffer, texture.image, mip, 1, vk::ImageLayout::eUndefined,
+                                vk::ImageLayout::eTransferDstOptimal);
+        command_buffer.copyBufferToImage(buffer, texture.image, vk::ImageLayout::eTransferDstOptimal, region);
+        transition_image_layout(command_buffer, texture.image, mip, 1, vk::ImageLayout::eTransferDstOptimal,
+                                vk::ImageLayout::eShaderReadOnlyOptimal);
+    }
+
+    vk::ImageView create_texture_view(uint32_t base_mip)
+    {
+        vk::ImageViewCreateInfo create_info{};
+        create_info.image = texture.image;
+        create_info.viewType = vk::ImageViewType::e2D;
+        create_info.format = texture.format;
+        create_info.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+        create_info.subresourceRange.baseMipLevel = base_mip;
+        create_info.subresourceRange.levelCount = texture.mip_count - base_mip;
+        create_info.subresourceRange.baseArrayLayer = 0;
+        create_info.subresourceRange.layerCount = 1;
+
+        auto res = device.createImageView(create_info);
+        if (res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to create texture image view" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        return res.value;
+    }
+
+    void create_texture()
+    {
+        const TextureFormatCandidate candidates[] = {
+            {vk::Format::eBc7SrgbBlock, ".bc7.ktx2"},
+            {vk::Format::eBc1RgbaSrgbBlock, ".bc1.ktx2"},
+            {vk::Format::eEtc2R8G8B8A8SrgbBlock, ".etc2.ktx2"},
+        };
+
+        for (const auto &candidate : candidates)
+        {
+            vk::FormatProperties format_properties = physical_device.getFormatProperties(candidate.format);
+            if (!(format_properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear))
+            {
+                continue;
+            }
+
+            std::string path = std::string(TEXTURE_PATH) + candidate.suffix;
+            std::string error;
+            Ktx2Info info;
+            if (!read_ktx2_info(path, info, error))
+            {
+                std::cerr << "texture: " << path << ": " << error << std::endl;
+                continue;
+            }
+
+            if (info.vk_format != (uint32_t)candidate.format)
+            {
+                std::cerr << "texture: " << path << ": expected " << vk::to_string(candidate.format) << std::endl;
+                continue;
+            }
+
+            if (load_streamed_texture(info, candidate.format))
+            {
+                return;
+            }
+        }
+
+        std::cerr << "texture: no usable compressed texture, using a white fallback" << std::endl;
+        create_fallback_texture();
+    }
+
+    bool load_streamed_texture(const Ktx2Info &info, vk::Format format)
+    {
+        const uint32_t level_count = (uint32_t)info.levels.size();
+
+        // smallest mips first until the budget is used up, the staging ring has to fit every streamed mip too
+        uint64_t budget_used = 0;
+        uint32_t first_level = level_count;
+        while (first_level > 0)
+        {
+            const Ktx2Level &level = info.levels[first_level - 1];
+            if (level.byte_length > TEXTURE_STAGING_RING_SIZE || budget_used + level.byte_length > TEXTURE_VRAM_BUDGET)
+            {
+                break;
+            }
+            budget_used += level.byte_length;
+            first_level--;
+        }
+
+        if (first_level == level_count)
+        {
+            std::cerr << "texture: " << info.path << ": smallest mip does not fit the budget" << std::endl;
+            return false;
+        }
+
+        texture.info = info;
+        texture.format = format;
+        texture.first_level = first_level;
+        texture.mip_count = level_count - first_level;
+
+        create_image(ktx2_level_width(info, first_level), ktx2_level_height(info, first_level), texture.mip_count,
+                     format, TEXTURE_USAGE, vk::MemoryPropertyFlagBits::eDeviceLocal, texture.image, texture.memory);
+
+        uint32_t tail_mip = texture.mip_count - 1;
+        while (tail_mip > 0 && std::max(ktx2_level_width(info, first_level + tail_mip - 1),
+                                        ktx2_level_height(info, first_level + tail_mip - 1)) <= TEXTURE_MIP_TAIL_SIZE)
+        {
+            tail_mip--;
+        }
+
+        // the mip tail is small, upload it synchronously so there is always something to sample
+        std::vector<vk::DeviceSize> offsets;
+        vk::DeviceSize tail_size = 0;
+        for (uint32_t mip = tail_mip; mip < texture.mip_count; mip++)
+        {
+            offsets.push_back(tail_size);
+            tail_size += (info.levels[first_level + mip].byte_length + 15) & ~vk::DeviceSize(15);
+        }
+
+        vk::Buffer staging_buffer;
+        vk::DeviceMemory staging_buffer_memory;
+        create_buffer(tail_size, vk::BufferUsageFlagBits::eTransferSrc,
+                      vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                      staging_buffer, staging_buffer_memory, MEMORY_PRIORITY_STAGING);
+
+        auto map_res = device.mapMemory(staging_buffer_memory, 0, tail_size);
+        if (map_res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to map staging buffer memory" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        std::ifstream file(info.path, std::ios::binary);
+        for (uint32_t mip = tail_mip; mip < texture.mip_count; mip++)
+        {
+            if (!read_ktx2_level(file, info, first_level + mip, (uint8_t *)map_res.value + offsets[mip - tail_mip]))
+            {
+                std::cerr << "failed to read texture level " << first_level + mip << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        device.unmapMemory(staging_buffer_memory);
+
+        vk::CommandBuffer command_buffer = begin_single_time_commands();
+        for (uint32_t mip = tail_mip; mip < texture.mip_count; mip++)
+        {
+            record_texture_copy(command_buffer, staging_buffer, offsets[mip - tail_mip], mip);
+        }
+        end_single_time_commands(command_buffer);
+
+        device.destroyBuffer(staging_buffer);
+        free_device_memory(staging_buffer_memory);
+
+        texture.resident_mip = tail_mip;
+        texture.view = create_texture_view(texture.resident_mip);
+
+        std::cerr << "texture: " << info.path << ", " << texture.mip_count << " mips, " << texture.mip_count - tail_mip
+                  << " resident at startup" << std::endl;
+        return true;
+    }
+
+    void create_fallback_texture()
+    {
+        const uint8_t white[4] = {255, 255, 255, 255};
+
+        texture.info = Ktx2Info{};
+        texture.format = vk::Format::eR8G8B8A8Unorm;
+        texture.first_level = 0;
+        texture.mip_count = 1;
+        texture.resident_mip = 0;
+
+        create_image(1, 1, 1, texture.format, vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+                     vk::MemoryPropertyFlagBits::eDeviceLocal, texture.image, texture.memory);
+
+        vk::Buffer staging_buffer;
+        vk::DeviceMemory staging_buffer_memory;
+        create_buffer(sizeof(white), vk::BufferUsageFlagBits::eTransferSrc,
+                      vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                      staging_buffer, staging_buffer_memory, MEMORY_PRIORITY_STAGING);
+
+        auto map_res = device.mapMemory(staging_buffer_memory, 0, sizeof(white));
+        if (map_res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to map staging buffer memory" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        memcpy(map_res.value, white, sizeof(white));
+        device.unmapMemory(staging_buffer_memory);
+
+        vk::BufferImageCopy region{};
+        region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = vk::Extent3D{1, 1, 1};
+
+        vk::CommandBuffer command_buffer = begin_single_time_commands();
+        transition_image_layout(command_buffer, texture.image, 0, 1, vk::ImageLayout::eUndefined,
+                                vk::ImageLayout::eTransferDstOptimal);
+        command_buffer.copyBufferToImage(staging_buffer, texture.image, vk::ImageLayout::eTransferDstOptimal, region);
+        transition_image_layout(command_buffer, texture.image, 0, 1, vk::ImageLayout::eTransferDstOptimal,
+                                vk::ImageLayout::eShaderReadOnlyOptimal);
+        end_single_time_commands(command_buffer);
+
+        device.destroyBuffer(staging_buffer);
+        free_device_memory(staging_buffer_memory);
+
+        texture.view = create_texture_view(0);
+    }
+
+    void create_texture_sampler()
+    {
+        vk::SamplerCreateInfo sampler_info{};
+        sampler_info.magFilter = vk::Filter::eLinear;
+        sampler_info.minFilter = vk::Filter::eLinear;
+        sampler_info.mipmapMode = vk::SamplerMipmapMode::eLinear;
+        sampler_info.addressModeU = vk::SamplerAddressMode::eRepeat;
+        sampler_info.addressModeV = vk::SamplerAddressMode::eRepeat;
+        sampler_info.addressModeW = vk::SamplerAddressMode::eRepeat;
+        sampler_info.anisotropyEnable = VK_FALSE;
+        sampler_info.maxAnisotropy = 1.0f;
+        sampler_info.borderColor = vk::BorderColor::eIntOpaqueBlack;
+        sampler_info.unnormalizedCoordinates = VK_FALSE;
+        sampler_info.compareEnable = VK_FALSE;
+        sampler_info.minLod = 0.0f;
+        sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+
+        auto res = device.createSampler(sampler_info);
+        if (res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to create texture sampler" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        texture_sampler = res.value;
+    }
+
+    // room for one DrawUniforms per drawn instance in every frame's region, mapped once and never written by the GPU
+    void create_uniform_ring()
+    {
+        size_t alignment = (size_t)physical_device.getProperties().limits.minUniformBufferOffsetAlignment;
+        size_t draws = std::min(simulation.instance_count(), (size_t)MAX_DRAWS_PER_FRAME);
+        size_t frame_size = draws * ((sizeof(DrawUniforms) + alignment - 1) / alignment * alignment);
+        size_t size = UniformRing::required_size(frame_size, MAX_FRAMES_IN_FLIGHT, alignment);
+        if (size == 0)
+        {
+            std::cerr << "uniform ring does not fit 32-bit offsets" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        create_buffer(size, vk::BufferUsageFlagBits::eUniformBuffer,
+                      vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                      uniform_buffer, uniform_buffer_memory, MEMORY_PRIORITY_FRAME);
+
+        auto map_res = device.mapMemory(uniform_buffer_memory, 0, size);
+        if (map_res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to map uniform buffer memory" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        if (!uniform_ring.init(map_res.value, frame_size, MAX_FRAMES_IN_FLIGHT, alignment))
+        {
+            std::cerr << "failed to initialize uniform ring" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    void create_descriptor_pool()
+    {
+        vk::DescriptorPoolSize pool_sizes[2]{};
+        pool_sizes[0].type = vk::DescriptorType::eCombinedImageSampler;
+        pool_sizes[0].descriptorCount = 1;
+        pool_sizes[1].type = vk::DescriptorType::eUniformBufferDynamic;
+        pool_sizes[1].descriptorCount = 1;
+
+        vk::DescriptorPoolCreateInfo pool_info{};
+        pool_info.setPoolSizes(pool_sizes);
+        pool_info.maxSets = 2;
+
+        auto res = device.createDescriptorPool(pool_info);
+        if (res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to create descriptor pool" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        descriptor_pool = res.value;
+    }
+
+    void create_descriptor_set()
+    {
+        vk::DescriptorSetAllocateInfo alloc_info{};
+        alloc_info.descriptorPool = descriptor_pool;
+        alloc_info.setSetLayouts(descriptor_set_layout);
+
+        auto res = device.allocateDescriptorSets(alloc_info);
+        if (res.result != vk::Result::eSuccess || res.value.size() != 1)
+        {
+            std::cerr << "failed to allocate descriptor sets" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        descriptor_set = res.value[0];
+        materials.push_back(descriptor_set);
+
+        write_texture_descriptor();
+        create_uniform_set();
+    }
+
+    // written once, draws select their DrawUniforms with the dynamic offset
+    void create_uniform_set()
+    {
+        vk::DescriptorSetAllocateInfo alloc_info{};
+        alloc_info.descriptorPool = descriptor_pool;
+        alloc_info.setSetLayouts(uniform_set_layout);
+
+        auto res = device.allocateDescriptorSets(alloc_info);
+        if (res.result != vk::Result::eSuccess || res.value.size() != 1)
+        {
+            std::cerr << "failed to allocate uniform descriptor set" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        uniform_set = res.value[0];
+
+        vk::DescriptorBufferInfo buffer_info{};
+        buffer_info.buffer = uniform_buffer;
+        buffer_info.offset = 0;
+        buffer_info.range = sizeof(DrawUniforms);
+
+        vk::WriteDescriptorSet descriptor_write{};
+        descriptor_write.dstSet = uniform_set;
+        descriptor_write.dstBinding = 0;
+        descriptor_write.dstArrayElement = 0;
+        descriptor_write.descriptorType = vk::DescriptorType::eUniformBufferDynamic;
+        descriptor_write.setBufferInfo(buffer_info);
+
+        device.updateDescriptorSets(descriptor_write, nullptr);
+    }
+
+    void write_texture_descriptor()
+    {
+        vk::DescriptorImageInfo image_info{};
+        image_info.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+        image_info.imageView = texture.view;
+        image_info.sampler = texture_sampler;
+
+        vk::WriteDescriptorSet descriptor_write{};
+        descriptor_write.dstSet = descriptor_set;
+        descriptor_write.dstBinding = 0;
+        descriptor_write.dstArrayElement = 0;
+        descriptor_write.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+        descriptor_write.setImageInfo(image_info);
+
+        device.updateDescriptorSets(descriptor_write, nullptr);
+    }
+
+    // both buffers are read and written by the compute and graphics families, concurrent sharing avoids queue
+    // family ownership transfers on every step
+    void create_particle_buffers()
+    {
+        if (particle_count == 0)
+        {
+            return;
+        }
+
+        QueueFamilyIndices indices = find_queue_families(physical_device);
+        const uint32_t families[2] = {indices.graphics_family.value(), indices.compute_family.value()};
+        const vk::DeviceSize size = (vk::DeviceSize)particle_count * sizeof(Particle);
+
+        for (uint32_t i = 0; i < 2; i++)
+        {
+            vk::BufferCreateInfo buffer_info{};
+            buffer_info.size = size;
+            buffer_info.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eVertexBuffer |
+                                vk::BufferUsageFlagBits::eTransferDst;
+            if (compute_queue_dedicated)
+            {
+                buffer_info.sharingMode = vk::SharingMode::eConcurrent;
+                buffer_info.setQueueFamilyIndices(families);
+            }
+            else
+            {
+                buffer_info.sharingMode = vk::SharingMode::eExclusive;
+            }
+
+            auto buffer_res = device.createBuffer(buffer_info);
+            if (buffer_res.result != vk::Result::eSuccess)
+            {
+                std::cerr << "failed to create particle buffer" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            particle_buffers[i] = buffer_res.value;
+
+            vk::MemoryRequirements mem_requirements = device.getBufferMemoryRequirements(particle_buffers[i]);
+
+            vk::MemoryAllocateInfo alloc_info{};
+            alloc_info.allocationSize = mem_requirements.size;
+            alloc_info.memoryTypeIndex =
+                find_memory_type(mem_requirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+            particle_buffer_memory[i] = allocate_device_memory(alloc_info, MEMORY_PRIORITY_FRAME);
+
+            if (device.bindBufferMemory(particle_buffers[i], particle_buffer_memory[i], 0) != vk::Result::eSuccess)
+            {
+                std::cerr << "failed to bind particle buffer memory" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        // the first step reads buffer 1
+        std::vector<Particle> particles = generate_particles(particle_count, PARTICLE_DISK_RADIUS, PARTICLE_GRAVITY);
+
+        vk::Buffer staging_buffer;
+        vk::DeviceMemory staging_buffer_memory;
+        create_buffer(size, vk::BufferUsageFlagBits::eTransferSrc,
+                      vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                      staging_buffer, staging_buffer_memory, MEMORY_PRIORITY_STAGING);
+
+        auto map_res = device.mapMemory(staging_buffer_memory, 0, size);
+        if (map_res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to map staging buffer memory" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        memcpy(map_res.value, particles.data(), (size_t)size);
+        device.unmapMemory(staging_buffer_memory);
+
+        vk::CommandBuffer command_buffer = begin_single_time_commands();
+        vk::BufferCopy copy_region{};
+        copy_region.size = size;
+        command_buffer.copyBuffer(staging_buffer, particle_buffers[1], copy_region);
+        end_single_time_commands(command_buffer);
+
+        device.destroyBuffer(staging_buffer);
+        free_device_memory(staging_buffer_memory);
+
+        create_particle_sets();
+        create_compute_commands();
+    }
+
+    // written once, set i simulates from buffer (i + 1) % 2 into buffer i
+    void create_particle_sets()
+    {
+        vk::DescriptorPoolSize pool_size{};
+        pool_size.type = vk::DescriptorType::eStorageBuffer;
+        pool_size.descriptorCount = 4;
+
+        vk::DescriptorPoolCreateInfo pool_info{};
+        pool_info.setPoolSizes(pool_size);
+        pool_info.maxSets = 2;
+
+        auto pool_res = device.createDescriptorPool(pool_info);
+        if (pool_res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to create particle descriptor pool" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        particle_descriptor_pool = pool_res.value;
+
+        const vk::DescriptorSetLayout layouts[2] = {particle_set_layout, particle_set_layout};
+        vk::DescriptorSetAllocateInfo alloc_info{};
+        alloc_info.descriptorPool = particle_descriptor_pool;
+        alloc_info.setSetLayouts(layouts);
+
+        auto res = device.allocateDescriptorSets(alloc_info);
+        if (res.result != vk::Result::eSuccess || res.value.size() != 2)
+        {
+            std::cerr << "failed to allocate particle descriptor sets" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        for (uint32_t i = 0; i < 2; i++)
+        {
+            particle_sets[i] = res.value[i];
+
+            vk::DescriptorBufferInfo buffer_infos[2]{};
+            buffer_infos[0].buffer = particle_buffers[(i + 1) % 2];
+            buffer_infos[0].range = VK_WHOLE_SIZE;
+            buffer_infos[1].buffer = particle_buffers[i];
+            buffer_infos[1].range = VK_WHOLE_SIZE;
+
+            vk::WriteDescriptorSet descriptor_write{};
+            descriptor_write.dstSet = particle_sets[i];
+            descriptor_write.dstBinding = 0;
+            descriptor_write.dstArrayElement = 0;
+            descriptor_write.descriptorType = vk::DescriptorType::eStorageBuffer;
+            descriptor_write.setBufferInfo(buffer_infos);
+
+            device.updateDescriptorSets(descriptor_write, nullptr);
+        }
+    }
+
+    void create_compute_commands()
+    {
+        QueueFamilyIndices indices = find_queue_families(physical_device);
+
+        vk::CommandPoolCreateInfo pool_info{};
+        pool_info.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+        pool_info.queueFamilyIndex = indices.compute_family.value();
+
+        auto pool_res = device.createCommandPool(pool_info);
+        if (pool_res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to create compute command pool" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        compute_command_pool = pool_res.value;
+
+        vk::CommandBufferAllocateInfo alloc_info{};
+        alloc_info.commandPool = compute_command_pool;
+        alloc_info.level = vk::CommandBufferLevel::ePrimary;
+        alloc_info.commandBufferCount = 2;
+
+        auto res = device.allocateCommandBuffers(alloc_info);
+        if (res.result != vk::Result::eSuccess || res.value.size() != 2)
+        {
+            std::cerr << "failed to allocate compute command buffers" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        for (uint32_t i = 0; i < 2; i++)
+        {
+            compute_command_buffers[i] = res.value[i];
+
+            auto simulated_res = device.createSemaphore({});
+            auto drawn_res = device.createSemaphore({});
+            if (simulated_res.result != vk::Result::eSuccess || drawn_res.result != vk::Result::eSuccess)
+            {
+                std::cerr << "failed to create particle semaphores" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            sem_particles_simulated[i] = simulated_res.value;
+            sem_particles_drawn[i] = drawn_res.value;
+        }
+    }
+
+    void start_metrics_server()
+    {
+        vk::PhysicalDeviceMemoryProperties mem_properties = physical_device.getMemoryProperties();
+        for (uint32_t i = 0; i < mem_properties.memoryHeapCount; i++)
+        {
+            metrics.heap_size_bytes[i].set((int64_t)mem_properties.memoryHeaps[i].size);
+        }
+        metrics.heap_count.store(mem_properties.memoryHeapCount, std::memory_order_relaxed);
+
+        const char *socket_path = getenv("LEARN_VULKAN_METRICS_SOCKET");
+        metrics_server.start(socket_path != nullptr ? socket_path : METRICS_SOCKET_PATH, &metrics);
+
+        last_frame_start = std::chrono::steady_clock::now();
+    }
+
+    void start_texture_streaming()
+    {
+        if (texture.resident_mip == 0)
+        {
+            return;
+        }
+
+        create_buffer(TEXTURE_STAGING_RING_SIZE, vk::BufferUsageFlagBits::eTransferSrc,
+                      vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                      staging_ring_buffer, staging_ring_memory, MEMORY_PRIORITY_STAGING);
+
+        auto map_res = device.mapMemory(staging_ring_memory, 0, TEXTURE_STAGING_RING_SIZE);
+        if (map_res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to map staging ring memory" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        staging_ring_data = (uint8_t *)map_res.value;
+        staging_ring.init(TEXTURE_STAGING_RING_SIZE);
+
+        texture_stream_thread = std::thread(&LearnVulkanApp::stream_texture_mips, this, texture.resident_mip);
+    }
+
+    // runs on texture_stream_thread, only reads texture fields that are fixed after load_streamed_texture()
+    void stream_texture_mips(uint32_t resident_mip)
+    {
+        std::ifstream file(texture.info.path, std::ios::binary);
+
+        // most detailed last, the texture sharpens progressively
+        for (uint32_t mip = resident_mip; mip-- > 0;)
+        {
+            uint32_t level = texture.first_level + mip;
+
+            TextureUpload upload{};
+            upload.mip = mip;
+            if (!staging_ring.allocate(texture.info.levels[level].byte_length, 16, upload.allocation))
+            {
+                return;
+            }
+
+            if (!read_ktx2_level(file, texture.info, level, staging_ring_data + upload.allocation.offset))
+            {
+                std::cerr << "texture: failed to read level " << level << ", streaming stopped" << std::endl;
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(texture_stream_mutex);
+            texture_uploads_ready.push_back(upload);
+        }
+    }
+
+    void stop_texture_streaming()
+    {
+        staging_ring.shutdown();
+        if (texture_stream_thread.joinable())
+        {
+            texture_stream_thread.join();
+        }
+    }
+
+    // called once the fence is waited on, so every recorded copy has finished
+    void update_texture_residency()
+    {
+        if (texture_uploads_recorded.empty())
+        {
+            return;
+        }
+
+        for (const auto &upload : texture_uploads_recorded)
+        {
+            staging_ring.release(upload.allocation.end);
+            texture.resident_mip = std::min(texture.resident_mip, upload.mip);
+        }
+        texture_uploads_recorded.clear();
+
+        // the descriptor set and old view are no longer in use by any frame
+        device.destroyImageView(texture.view);
+        texture.view = create_texture_view(texture.resident_mip);
+        write_texture_descriptor();
+    }
+
+    void init_memory_budget()
+    {
+        const char *cap_env = getenv("LEARN_VULKAN_MEMORY_BUDGET_MB");
+        memory_budget_cap = cap_env != nullptr ? (vk::DeviceSize)atoll(cap_env) * 1024 * 1024 : 0;
+    }
+
+    // per heap usage of this process and what it may use, both capped by LEARN_VULKAN_MEMORY_BUDGET_MB
+    void sample_memory_budget(vk::DeviceSize usage[VK_MAX_MEMORY_HEAPS], vk::DeviceSize budget[VK_MAX_MEMORY_HEAPS])
+    {
+        vk::PhysicalDeviceMemoryProperties mem_properties = physical_device.getMemoryProperties();
+
+        if (memory_budget_supported)
+        {
+            vk::PhysicalDeviceMemoryBudgetPropertiesEXT budget_properties{};
+            vk::PhysicalDeviceMemoryProperties2 properties{};
+            properties.pNext = &budget_properties;
+            get_memory_properties2(physical_device, reinterpret_cast<VkPhysicalDeviceMemoryProperties2 *>(&properties));
+
+            for (uint32_t i = 0; i < mem_properties.memoryHeapCount; i++)
+            {
+                usage[i] = budget_properties.heapUsage[i];
+                budget[i] = budget_properties.heapBudget[i];
+            }
+        }
+        else
+        {
+            // only what the app allocated itself is known
+            for (uint32_t i = 0; i < mem_properties.memoryHeapCount; i++)
+            {
+                usage[i] = 0;
+                budget[i] = (vk::DeviceSize)(mem_properties.memoryHeaps[i].size * MEMORY_BUDGET_HEAP_FRACTION);
+            }
+            for (const auto &allocation : device_allocations)
+            {
+                usage[allocation.second.heap] += allocation.second.size;
+            }
+        }
+
+        if (memory_budget_cap != 0)
+        {
+            for (uint32_t i = 0; i < mem_properties.memoryHeapCount; i++)
+            {
+                budget[i] = std::min(budget[i], memory_budget_cap);
+            }
+        }
+    }
+
+    // called once the fence is waited on, eviction may replace resources the previous frame used
+    void update_memory_budget()
+    {
+        if (frames_until_budget_check > 0)
+        {
+            frames_until_budget_check--;
+            return;
+        }
+        frames_until_budget_check = MEMORY_BUDGET_CHECK_FRAMES;
+
+        vk::DeviceSize usage[VK_MAX_MEMORY_HEAPS];
+        vk::DeviceSize budget[VK_MAX_MEMORY_HEAPS];
+        sample_memory_budget(usage, budget);
+
+        uint32_t heap_count = physical_device.getMemoryProperties().memoryHeapCount;
+        for (uint32_t heap = 0; heap < heap_count; heap++)
+        {
+            metrics.heap_usage_bytes[heap].set((int64_t)usage[heap]);
+            metrics.heap_budget_bytes[heap].set((int64_t)budget[heap]);
+
+            if ((double)usage[heap] <= (double)budget[heap] * MEMORY_BUDGET_HIGH_WATER)
+            {
+                eviction_exhausted[heap] = false;
+                continue;
+            }
+
+            // one step per check, the next sample shows whether it was enough
+            const char *step = evict_memory(heap);
+            if (step != nullptr)
+            {
+                metrics.memory_evictions.add();
+            }
+            else
+            {
+                metrics.memory_evictions_exhausted.add();
+                if (eviction_exhausted[heap])
+                {
+                    continue;
+                }
+                eviction_exhausted[heap] = true;
+            }
+            std::cerr << "memory: heap " << heap << " at " << usage[heap] / (1024 * 1024) << " of "
+                      << budget[heap] / (1024 * 1024) << " MiB, " << (step != nullptr ? step : "nothing left to evict")
+                      << std::endl;
+        }
+    }
+
+    uint32_t allocation_heap(vk::DeviceMemory memory)
+    {
+        auto it = device_allocations.find(static_cast<VkDeviceMemory>(memory));
+        return it != device_allocations.end() ? it->second.heap : UINT32_MAX;
+    }
+
+    // Cheapest first: the staging ring only feeds texture streaming, then texture detail from the top mip down to
+    // the mip tail. Geometry, uniforms and render targets are needed every frame and are never evicted. Returns what
+    // was done, or nullptr if nothing on the heap can go.
+    const char *evict_memory(uint32_t heap)
+    {
+        if (staging_ring_buffer && allocation_heap(staging_ring_memory) == heap)
+        {
+            release_staging_ring();
+            return "freed the texture staging ring";
+        }
+
+        if (texture_mip_droppable() && allocation_heap(texture.memory) == heap)
+        {
+            drop_texture_mip();
+            return "dropped the top texture mip";
+        }
+
+        return nullptr;
+    }
+
+    // stops texture streaming, mips that are not resident yet stay missing
+    void release_staging_ring()
+    {
+        stop_texture_streaming();
+        texture_uploads_ready.clear();
+
+        device.destroyBuffer(staging_ring_buffer);
+        free_device_memory(staging_ring_memory);
+        staging_ring_buffer = nullptr;
+        staging_ring_memory = nullptr;
+        staging_ring_data = nullptr;
+    }
+
+    // the mip tail always stays
+    bool texture_mip_droppable()
+    {
+        if (texture.mip_count <= 1)
+        {
+            return false;
+        }
+        uint32_t width = ktx2_level_width(texture.info, texture.first_level);
+        uint32_t height = ktx2_level_height(texture.info, texture.first_level);
+        return std::max(width, height) > TEXTURE_MIP_TAIL_SIZE;
+    }
+
+    // Replaces the texture with one that starts a level lower, the resident mips are copied over on the GPU. Both
+    // images are alive during the copy, so a heap already over budget grows by about a quarter of the old texture
+    // before the old one is freed.
+    void drop_texture_mip()
+    {
+        // streamed uploads address mips of the current image
+        if (staging_ring_buffer)
+        {
+            release_staging_ring();
+        }
+
+        const uint32_t first_level = texture.first_level + 1;
+        const uint32_t mip_count = texture.mip_count - 1;
+        const uint32_t resident_mip = texture.resident_mip > 0 ? texture.resident_mip - 1 : 0;
+
+        vk::Image image;
+        vk::DeviceMemory memory;
+        create_image(ktx2_level_width(texture.info, first_level), ktx2_level_height(texture.info, first_level),
+                     mip_count, texture.format, TEXTURE_USAGE, vk::MemoryPropertyFlagBits::eDeviceLocal, image,
+                     memory);
+
+        vk::CommandBuffer command_buffer = begin_single_time_commands();
+        transition_image_layout(command_buffer, texture.image, resident_mip + 1, mip_count - resident_mip,
+                                vk::ImageLayout::eShaderReadOnlyOptimal, vk::ImageLayout::eTransferSrcOptimal);
+        transition_image_layout(command_buffer, image, resident_mip, mip_count - resident_mip,
+                                vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+
+        for (uint32_t mip = resident_mip; mip < mip_count; mip++)
+        {
+            vk::ImageCopy region{};
+            region.srcSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+            region.srcSubresource.mipLevel = mip + 1;
+            region.srcSubresource.layerCount = 1;
+            region.dstSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+            region.dstSubresource.mipLevel = mip;
+            region.dstSubresource.layerCount = 1;
+            region.extent = vk::Extent3D{ktx2_level_width(texture.info, first_level + mip),
+                                         ktx2_level_height(texture.info, first_level + mip), 1};
+            command_buffer.copyImage(texture.image, vk::ImageLayout::eTransferSrcOptimal, image,
+                                     vk::ImageLayout::eTransferDstOptimal, region);
+        }
+
+        transition_image_layout(command_buffer, image, resident_mip, mip_count - resident_mip,
+                                vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+        end_single_time_commands(command_buffer);
+
+        device.destroyImageView(texture.view);
+        device.destroyImage(texture.image);
+        free_device_memory(texture.memory);
+
+        texture.image = image;
+        texture.memory = memory;
+        texture.first_level = first_level;
+        texture.mip_count = mip_count;
+        texture.resident_mip = resident_mip;
+        texture.view = create_texture_view(texture.resident_mip);
+        write_texture_descriptor();
+    }
+
+    void record_texture_uploads(vk::CommandBuffer command_buffer)
+    {
+        // the stream thread only holds the lock to push, never stall the frame on it
+        std::unique_lock<std::mutex> lock(texture_stream_mutex, std::try_to_lock);
+        if (!lock.owns_lock() || texture_uploads_ready.empty())
+        {
+            return;
+        }
+
+        uint64_t bytes = 0;
+        size_t count = 0;
+        for (const auto &upload : texture_uploads_ready)
+        {
+            uint64_t size = texture.info.levels[texture.first_level + upload.mip].byte_length;
+            if (count > 0 && bytes + size > TEXTURE_UPLOAD_BYTES_PER_FRAME)
+            {
+                break;
+            }
+            bytes += size;
+            count++;
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const TextureUpload &upload = texture_uploads_ready[i];
+            record_texture_copy(command_buffer, staging_ring_buffer, upload.allocation.offset, upload.mip);
+            texture_uploads_recorded.push_back(upload);
+        }
+        texture_uploads_ready.erase(texture_uploads_ready.begin(), texture_uploads_ready.begin() + count);
+    }
+
+    void create_command_buffers()
+    {
+        vk::CommandBufferAllocateInfo alloc_info{};
+        alloc_info.commandPool = command_pool;
+        alloc_info.level = vk::CommandBufferLevel::ePrimary;
+        alloc_info.commandBufferCount = (uint32_t)windows.size();
+
+        auto res = device.allocateCommandBuffers(alloc_info);
+        if (res.result != vk::Result::eSuccess || res.value.size() != windows.size())
+        {
+            std::cerr << "failed to allocate command buffers" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        for (size_t i = 0; i < windows.size(); i++)
+        {
+            windows[i].command_buffer = res.value[i];
+        }
+    }
+
+    // texture uploads and the timestamp reset go into the first window's command buffer, it is the first one
+    // in the submit
+    void record_command_buffer(const WindowTarget &target, uint32_t window_index)
+    {
+        vk::CommandBuffer command_buffer = target.command_buffer;
+        const bool first_window = window_index == 0;
+
+        vk::CommandBufferBeginInfo begin_info{};
+        if (command_buffer.begin(begin_info) != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to begin recording command buffer" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        if (first_window)
+        {
+            if (timestamps_supported)
+            {
+                command_buffer.resetQueryPool(timestamp_query_pool, 0, 2 * (uint32_t)windows.size());
+            }
+            record_texture_uploads(command_buffer);
+        }
+
+        // every command of the first window is mirrored into the capture while one is being recorded
+        const bool capturing = first_window && capture.is_open();
+
+        // only the top left corner of the render target is used below the maximum scale
+        const vk::Extent2D render_extent = scaled_extent(target.extent, resolution_scaler.scale());
+
+        vk::RenderPassBeginInfo render_pass_info{};
+        render_pass_info.renderPass = render_pass;
+        render_pass_info.framebuffer = target.framebuffer;
+        render_pass_info.renderArea.offset = vk::Offset2D{0, 0};
+        render_pass_info.renderArea.extent = render_extent;
+        const float clear_color[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+        vk::ClearValue clear_values[2];
+        clear_values[0].color = vk::ClearColorValue(clear_color[0], clear_color[1], clear_color[2], clear_color[3]);
+        clear_values[1].depthStencil = vk::ClearDepthStencilValue(1.0f, 0);
+        render_pass_info.setClearValues(clear_values);
+
+        if (timestamps_supported)
+        {
+            command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, timestamp_query_pool,
+                                          2 * window_index);
+        }
+
+        command_buffer.beginRenderPass(render_pass_info, vk::SubpassContents::eInline);
+        if (capturing)
+        {
+            capture.begin_render_pass(render_extent, clear_color);
+        }
+
+        vk::Viewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = (float)render_extent.width;
+        viewport.height = (float)render_extent.height;
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        command_buffer.setViewport(0, viewport);
+
+        vk::Rect2D scissor{};
+        scissor.offset = vk::Offset2D{0, 0};
+        scissor.extent = render_extent;
+        command_buffer.setScissor(0, scissor);
+
+        vk::DeviceSize vertex_offset = 0;
+        command_buffer.bindVertexBuffers(0, vertex_buffer, vertex_offset);
+        command_buffer.bindIndexBuffer(index_buffer, 0, vk::IndexType::eUint32);
+        if (capturing)
+        {
+            capture.set_viewport(viewport);
+            capture.set_scissor(scissor);
+            capture.bind_vertex_buffer(vertex_buffer, vertex_offset);
+            capture.bind_index_buffer(index_buffer, 0, vk::IndexType::eUint32);
+        }
+
+        record_draws(command_buffer, capturing);
+        record_particles(command_buffer);
+
+        command_buffer.endRenderPass();
+        if (capturing)
+        {
+            capture.end_render_pass();
+        }
+
+        if (timestamps_supported)
+        {
+            command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, timestamp_query_pool,
+                                          2 * window_index + 1);
+        }
+
+        record_upscale(command_buffer, target, render_extent);
+
+        if (command_buffer.end() != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to record command buffer" << std::endl;
+            exit(EXIT_FAILURE);
         }
     }
 
-    void create_sync_objects()
+    // draws are sorted by pipeline, then material, so a bind is only needed where the key changes. Compared by
+    // handle, variants still compiling share the fallback pipeline. The uniform set is rebound for every draw with
+    // its own dynamic offset, which leaves the material set bound.
+    void record_draws(vk::CommandBuffer command_buffer, bool capturing)
+    {
+        vk::Pipeline bound_pipeline;
+        vk::DescriptorSet bound_material;
+
+        for (size_t i = 0; i < draw_list.size(); i++)
+        {
+            const DrawItem &draw = draw_list[i];
+
+            const PipelineKey &key = pipeline_variants[draw_key_pipeline(draw.key)];
+            vk::Pipeline pipeline = pipeline_manager.get(shader_program, key, graphics_pipeline);
+            if (pipeline != bound_pipeline)
+            {
+                command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+                if (capturing)
+                {
+                    // the fallback is the default variant
+                    const PipelineKey &bound_key = pipeline == graphics_pipeline ? pipeline_variants[0] : key;
+                    capture.bind_pipeline(hash_pipeline(shader_program, bound_key), bound_key);
+                }
+                bound_pipeline = pipeline;
+                draw_stats.pipeline_binds++;
+            }
+            else
+            {
+                draw_stats.pipeline_binds_skipped++;
+            }
+
+            vk::DescriptorSet material = materials[draw_key_material(draw.key)];
+            if (material != bound_material)
+            {
+                command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout, 0, material,
+                                                  nullptr);
+                if (capturing)
+                {
+                    capture.bind_descriptor_set();
+                }
+                bound_material = material;
+                draw_stats.material_binds++;
+            }
+            else
+            {
+                draw_stats.material_binds_skipped++;
+            }
+
+            command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout, 1, uniform_set,
+                                              draw.uniform_offset);
+
+            DrawPushConstants push{};
+            instance_tint(draw.instance, push.tint);
+            command_buffer.pushConstants(pipeline_layout, vk::ShaderStageFlagBits::eFragment, 0, sizeof(push), &push);
+
+            if (capturing)
+            {
+                capture.bind_uniforms(*(const DrawUniforms *)uniform_ring.at(draw.uniform_offset));
+                capture.push_constants(push);
+            }
+
+            command_buffer.drawIndexed(draw.index_count, 1, draw.first_index, draw.vertex_offset, 0);
+            if (capturing)
+            {
+                capture.draw_indexed(draw.index_count, 1, draw.first_index, draw.vertex_offset, 0);
+            }
+            draw_stats.draws++;
+        }
+    }
+
+    // the mesh keeps its own colors, the other instances get a random tint so they can be told apart
+    static void instance_tint(uint32_t instance, float tint[4])
+    {
+        if (instance == SIM_MESH_INSTANCE)
+        {
+            tint[0] = tint[1] = tint[2] = tint[3] = 1.0f;
+            return;
+        }
+
+        uint32_t hash = instance * 2654435761u;
+        tint[0] = 0.25f + 0.75f * (float)(hash & 0xFF) / 255.0f;
+        tint[1] = 0.25f + 0.75f * (float)((hash >> 8) & 0xFF) / 255.0f;
+        tint[2] = 0.25f + 0.75f * (float)((hash >> 16) & 0xFF) / 255.0f;
+        tint[3] = 1.0f;
+    }
+
+    // the render pass leaves the render target in TransferSrcOptimal, the blit covers the whole swapchain image
+    void record_upscale(vk::CommandBuffer command_buffer, const WindowTarget &target, vk::Extent2D render_extent)
+    {
+        vk::Image swapchain_image = target.images[target.image_index];
+
+        vk::ImageMemoryBarrier barrier{};
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = swapchain_image;
+        barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+
+        // chained to the acquire semaphore, which is waited on at the transfer stage
+        barrier.oldLayout = vk::ImageLayout::eUndefined;
+        barrier.newLayout = vk::ImageLayout::eTransferDstOptimal;
+        barrier.srcAccessMask = vk::AccessFlagBits::eNoneKHR;
+        barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer,
+                                       vk::DependencyFlags(), nullptr, nullptr, barrier);
+
+        vk::ImageBlit region{};
+        region.srcSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+        region.srcSubresource.layerCount = 1;
+        region.srcOffsets[1] = vk::Offset3D{(int32_t)render_extent.width, (int32_t)render_extent.height, 1};
+        region.dstSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+        region.dstSubresource.layerCount = 1;
+        region.dstOffsets[1] = vk::Offset3D{(int32_t)target.extent.width, (int32_t)target.extent.height, 1};
+
+        command_buffer.blitImage(target.render_image, vk::ImageLayout::eTransferSrcOptimal, swapchain_image,
+                                 vk::ImageLayout::eTransferDstOptimal, region, upscale_filter);
+
+        // made visible to the presentation engine by the render finished semaphore
+        barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+        barrier.newLayout = vk::ImageLayout::ePresentSrcKHR;
+        barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        barrier.dstAccessMask = vk::AccessFlagBits::eNoneKHR;
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                       vk::PipelineStageFlagBits::eBottomOfPipe, vk::DependencyFlags(), nullptr,
+                                       nullptr, barrier);
+    }
+
+    void create_timestamp_queries()
+    {
+        QueueFamilyIndices indices = find_queue_families(physical_device);
+        std::vector<vk::QueueFamilyProperties> families = physical_device.getQueueFamilyProperties();
+
+        timestamps_supported = families[indices.graphics_family.value()].timestampValidBits > 0;
+        if (!timestamps_supported)
+        {
+            std::cerr << "render scale: no timestamp support, staying at " << resolution_scaler.scale() << std::endl;
+            return;
+        }
+        timestamp_period = physical_device.getProperties().limits.timestampPeriod;
+
+        // a begin and end query per window
+        vk::QueryPoolCreateInfo query_info{};
+        query_info.queryType = vk::QueryType::eTimestamp;
+        query_info.queryCount = 2 * (uint32_t)windows.size();
+
+        auto res = device.createQueryPool(query_info);
+        if (res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to create timestamp query pool" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        timestamp_query_pool = res.value;
+    }
+
+    // called once the fence is waited on, the queries of the last frame are available
+    void update_render_scale()
+    {
+        if (!timestamps_pending)
+        {
+            return;
+        }
+        timestamps_pending = false;
+
+        std::vector<uint64_t> timestamps(2 * windows.size());
+        auto res = device.getQueryPoolResults(timestamp_query_pool, 0, (uint32_t)timestamps.size(),
+                                              timestamps.size() * sizeof(uint64_t), timestamps.data(),
+                                              sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+        if (res != vk::Result::eSuccess)
+        {
+            return;
+        }
+
+        uint64_t ticks = 0;
+        for (size_t i = 0; i < windows.size(); i++)
+        {
+            ticks += timestamps[2 * i + 1] - timestamps[2 * i];
+        }
+        double gpu_us = (double)ticks * timestamp_period / 1000.0;
+        metrics.gpu_render_us.observe((uint64_t)gpu_us);
+
+        float gpu_ms = (float)(gpu_us / 1000.0);
+        if (resolution_scaler.add_sample(gpu_ms))
+        {
+            std::cerr << "render scale: " << resolution_scaler.scale() << " after " << gpu_ms << " ms" << std::endl;
+        }
+        metrics.render_scale_percent.set((int64_t)(resolution_scaler.scale() * 100.0f + 0.5f));
+    }
+
+    void create_particle_queries()
+    {
+        if (particle_count == 0)
+        {
+            return;
+        }
+
+        QueueFamilyIndices indices = find_queue_families(physical_device);
+        std::vector<vk::QueueFamilyProperties> families = physical_device.getQueueFamilyProperties();
+
+        particle_timestamps_supported = families[indices.compute_family.value()].timestampValidBits > 0;
+        if (!particle_timestamps_supported)
+        {
+            std::cerr << "particles: no timestamp support on the compute queue, particles per second not measured"
+                      << std::endl;
+            return;
+        }
+        timestamp_period = physical_device.getProperties().limits.timestampPeriod;
+
+        vk::QueryPoolCreateInfo query_info{};
+        query_info.queryType = vk::QueryType::eTimestamp;
+        query_info.queryCount = 4;
+
+        auto res = device.createQueryPool(query_info);
+        if (res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to create particle query pool" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        particle_query_pool = res.value;
+    }
+
+    // called once the fence is waited on. The last frame waited for step particle_step - 2, which used the same
+    // queries and command buffer as the step about to be recorded, step particle_step - 1 may still be running.
+    void update_particle_metrics()
+    {
+        if (!particle_timestamps_supported || particle_step < 2)
+        {
+            return;
+        }
+
+        const uint32_t parity = (uint32_t)(particle_step % 2);
+        uint64_t timestamps[2] = {};
+        auto res = device.getQueryPoolResults(particle_query_pool, 2 * parity, 2, sizeof(timestamps), timestamps,
+                                              sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+        if (res != vk::Result::eSuccess)
+        {
+            return;
+        }
+
+        double gpu_us = (double)(timestamps[1] - timestamps[0]) * timestamp_period / 1000.0;
+        metrics.particle_sim_us.observe((uint64_t)gpu_us);
+        if (gpu_us > 0.0)
+        {
+            metrics.particles_per_second.set((int64_t)(particle_count * 1e6 / gpu_us));
+        }
+    }
+
+    // submitted ahead of the frame's graphics work, which does not depend on it
+    void simulate_particles(float dt)
     {
-        auto sem_img_res = device.createSemaphore({});
-        if (sem_img_res.result != vk::Result::eSuccess)
+        if (particle_count == 0)
+        {
+            return;
+        }
+
+        const uint32_t parity = (uint32_t)(particle_step % 2);
+        vk::CommandBuffer command_buffer = compute_command_buffers[parity];
+        command_buffer.reset(vk::CommandBufferResetFlags());
+
+        vk::CommandBufferBeginInfo begin_info{};
+        begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+        if (command_buffer.begin(begin_info) != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to begin recording compute command buffer" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        // submission order alone does not order two dispatches: this step reads what the previous one wrote and
+        // overwrites what it read, neither semaphore covers that when both run on a dedicated compute queue
+        vk::MemoryBarrier barrier{};
+        barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+        barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                       vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), barrier,
+                                       nullptr, nullptr);
+
+        if (particle_timestamps_supported)
+        {
+            command_buffer.resetQueryPool(particle_query_pool, 2 * parity, 2);
+            command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, particle_query_pool, 2 * parity);
+        }
+
+        ParticleSimParams params{};
+        params.dt = std::min(dt, PARTICLE_MAX_DT);
+        params.gravity = PARTICLE_GRAVITY;
+        params.count = particle_count;
+
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, particle_sim_pipeline);
+        command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, particle_sim_layout, 0,
+                                          particle_sets[parity], nullptr);
+        command_buffer.pushConstants(particle_sim_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(params),
+                                     &params);
+        command_buffer.dispatch((particle_count + PARTICLE_WORKGROUP_SIZE - 1) / PARTICLE_WORKGROUP_SIZE, 1, 1);
+
+        if (particle_timestamps_supported)
+        {
+            command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, particle_query_pool,
+                                          2 * parity + 1);
+        }
+
+        if (command_buffer.end() != vk::Result::eSuccess)
         {
-            std::cerr << "failed to create image available semaphore" << std::endl;
+            std::cerr << "failed to record compute command buffer" << std::endl;
             exit(EXIT_FAILURE);
         }
-        sem_image_available = sem_img_res.value;
 
-        auto sem_render_res = device.createSemaphore({});
-        if (sem_render_res.result != vk::Result::eSuccess)
+        // the buffer written here was drawn by the previous frame
+        const vk::PipelineStageFlags wait_stage = vk::PipelineStageFlagBits::eComputeShader;
+        vk::SubmitInfo submit_info{};
+        if (particle_step > 0)
+        {
+            submit_info.setWaitSemaphores(sem_particles_drawn[(parity + 1) % 2]);
+            submit_info.setWaitDstStageMask(wait_stage);
+        }
+        submit_info.setCommandBuffers(command_buffer);
+        submit_info.setSignalSemaphores(sem_particles_simulated[parity]);
+
+        if (compute_queue.submit(submit_info, nullptr) != vk::Result::eSuccess)
         {
-            std::cerr << "failed to create render finished semaphore" << std::endl;
+            std::cerr << "failed to submit compute command buffer" << std::endl;
             exit(EXIT_FAILURE);
         }
-        sem_render_finished = sem_render_res.value;
+        metrics.queue_submits.add();
+        metrics.particles_simulated.add(particle_count);
+    }
+
+    // not captured, replay has no compute queue to simulate them
+    void record_particles(vk::CommandBuffer command_buffer)
+    {
+        if (particle_count == 0)
+        {
+            return;
+        }
+
+        ParticleDrawParams params{};
+        memcpy(params.view_projection, view_projection, sizeof(params.view_projection));
+
+        vk::DeviceSize offset = 0;
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, particle_draw_pipeline);
+        command_buffer.bindVertexBuffers(0, particle_buffers[(particle_step + 1) % 2], offset);
+        command_buffer.pushConstants(particle_draw_layout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(params),
+                                     &params);
+        command_buffer.draw(particle_count, 1, 0, 0);
+    }
+
+    void create_sync_objects()
+    {
+        for (auto &target : windows)
+        {
+            auto sem_img_res = device.createSemaphore({});
+            if (sem_img_res.result != vk::Result::eSuccess)
+            {
+                std::cerr << "failed to create image available semaphore" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            target.sem_image_available = sem_img_res.value;
+
+            auto sem_render_res = device.createSemaphore({});
+            if (sem_render_res.result != vk::Result::eSuccess)
+            {
+                std::cerr << "failed to create render finished semaphore" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            target.sem_render_finished = sem_render_res.value;
+        }
 
         auto fence_res = device.createFence({vk::FenceCreateFlagBits::eSignaled});
         if (fence_res.result != vk::Result::eSuccess)
@@ -857,9 +3135,22 @@ class LearnVulkanApp
         fence_in_flight = fence_res.value;
     }
 
+    bool should_close()
+    {
+        for (const auto &target : windows)
+        {
+            if (glfwWindowShouldClose(target.window))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // the simulation ticks on its own thread, this one only polls events and renders
     void main_loop()
     {
-        while (!glfwWindowShouldClose(window))
+        while (!should_close())
         {
             glfwPollEvents();
             draw_frame();
@@ -868,6 +3159,11 @@ class LearnVulkanApp
 
     void draw_frame()
     {
+        auto frame_start = std::chrono::steady_clock::now();
+        uint64_t frame_time_us = elapsed_us(last_frame_start, frame_start);
+        metrics.frame_time_us.observe(frame_time_us);
+        last_frame_start = frame_start;
+
         auto res_wait = device.waitForFences(fence_in_flight, VK_TRUE, std::numeric_limits<uint64_t>::max());
         if (res_wait != vk::Result::eSuccess)
         {
@@ -876,41 +3172,162 @@ class LearnVulkanApp
         }
         device.resetFences(fence_in_flight);
 
-        uint32_t image_index;
-        auto res_next = device.acquireNextImageKHR(swapchain, std::numeric_limits<uint64_t>::max(), sem_image_available,
-                                                   nullptr, &image_index);
-        if (res_next != vk::Result::eSuccess)
+        auto fence_end = std::chrono::steady_clock::now();
+        metrics.fence_wait_us.observe(elapsed_us(frame_start, fence_end));
+
+        update_texture_residency();
+        update_memory_budget();
+        update_render_scale();
+        update_particle_metrics();
+        simulate_particles((float)frame_time_us / 1e6f);
+        const FrameSnapshot &snapshot = acquire_snapshot();
+        cull_instances(snapshot);
+        build_draw_list(snapshot);
+
+        auto acquire_start = std::chrono::steady_clock::now();
+        for (auto &target : windows)
         {
-            std::cerr << "failed to acquire next image" << std::endl;
-            exit(EXIT_FAILURE);
+            auto res_next = device.acquireNextImageKHR(target.swapchain, std::numeric_limits<uint64_t>::max(),
+                                                       target.sem_image_available, nullptr, &target.image_index);
+            if (res_next != vk::Result::eSuccess)
+            {
+                std::cerr << "failed to acquire next image" << std::endl;
+                exit(EXIT_FAILURE);
+            }
         }
 
-        command_buffer.reset(vk::CommandBufferResetFlags());
-        record_command_buffer(command_buffer, image_index);
+        auto record_start = std::chrono::steady_clock::now();
+        metrics.acquire_wait_us.observe(elapsed_us(acquire_start, record_start));
+
+        if (capture.is_open())
+        {
+            capture.begin_frame();
+        }
+
+        draw_stats = DrawStats{};
+        for (size_t i = 0; i < windows.size(); i++)
+        {
+            windows[i].command_buffer.reset(vk::CommandBufferResetFlags());
+            record_command_buffer(windows[i], (uint32_t)i);
+        }
+        count_draw_stats();
+
+        if (capture.is_open())
+        {
+            capture.end_frame();
+            if (capture.frames_written() >= capture_frame_limit)
+            {
+                std::cerr << "capture: wrote " << capture.frames_written() << " frames" << std::endl;
+                capture.close();
+            }
+        }
+
+        auto submit_start = std::chrono::steady_clock::now();
+        metrics.record_us.observe(elapsed_us(record_start, submit_start));
+
+        // every window goes into one batch, swapchain images are first touched by the upscale blit so the acquire
+        // waits only block transfers and rendering can start before all images are available
+        std::vector<vk::Semaphore> wait_semaphores;
+        std::vector<vk::PipelineStageFlags> wait_stages;
+        std::vector<vk::CommandBuffer> command_buffers;
+        std::vector<vk::Semaphore> signal_semaphores;
+        std::vector<vk::SwapchainKHR> swapchains;
+        std::vector<uint32_t> image_indices;
+        for (const auto &target : windows)
+        {
+            wait_semaphores.push_back(target.sem_image_available);
+            wait_stages.push_back(vk::PipelineStageFlagBits::eTransfer);
+            command_buffers.push_back(target.command_buffer);
+            signal_semaphores.push_back(target.sem_render_finished);
+            swapchains.push_back(target.swapchain);
+            image_indices.push_back(target.image_index);
+        }
+
+        // the points drawn this frame were written by the previous step, the next step overwrites them. The
+        // particle semaphores are left out of the present wait.
+        std::vector<vk::Semaphore> submit_signal_semaphores = signal_semaphores;
+        const uint32_t parity = (uint32_t)(particle_step % 2);
+        if (particle_count > 0)
+        {
+            if (particle_step > 0)
+            {
+                wait_semaphores.push_back(sem_particles_simulated[(parity + 1) % 2]);
+                wait_stages.push_back(vk::PipelineStageFlagBits::eVertexInput);
+            }
+            submit_signal_semaphores.push_back(sem_particles_drawn[parity]);
+        }
 
-        vk::PipelineStageFlags wait_stage = vk::PipelineStageFlagBits::eColorAttachmentOutput;
         vk::SubmitInfo submit_info{};
-        submit_info.setWaitSemaphores(sem_image_available);
-        submit_info.setWaitDstStageMask(wait_stage);
-        submit_info.setCommandBuffers(command_buffer);
-        submit_info.setSignalSemaphores(sem_render_finished);
+        submit_info.setWaitSemaphores(wait_semaphores);
+        submit_info.setWaitDstStageMask(wait_stages);
+        submit_info.setCommandBuffers(command_buffers);
+        submit_info.setSignalSemaphores(submit_signal_semaphores);
 
         if (graphics_queue.submit(submit_info, fence_in_flight) != vk::Result::eSuccess)
         {
             std::cerr << "failed to submit draw command buffer" << std::endl;
             exit(EXIT_FAILURE);
         }
+        metrics.queue_submits.add();
+        timestamps_pending = timestamps_supported;
 
-        vk::PresentInfoKHR present_info{};
-        present_info.setWaitSemaphores(sem_render_finished);
-        present_info.setSwapchains(swapchain);
-        present_info.setImageIndices(image_index);
+        auto present_start = std::chrono::steady_clock::now();
+        metrics.submit_us.observe(elapsed_us(submit_start, present_start));
 
-        if (present_queue.presentKHR(present_info) != vk::Result::eSuccess)
+        std::vector<vk::Result> present_results(windows.size());
+        vk::PresentInfoKHR present_info{};
+        present_info.setWaitSemaphores(signal_semaphores);
+        present_info.setSwapchains(swapchains);
+        present_info.setImageIndices(image_indices);
+        present_info.setResults(present_results);
+
+        vk::Result res_present = present_queue.presentKHR(present_info);
+        metrics.present_us.observe(elapsed_us(present_start, std::chrono::steady_clock::now()));
+        for (vk::Result result : present_results)
+        {
+            count_present_result(result);
+        }
+        if (res_present != vk::Result::eSuccess)
         {
             std::cerr << "failed to present image" << std::endl;
             exit(EXIT_FAILURE);
         }
+
+        metrics.frames.add();
+        current_frame = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+        if (particle_count > 0)
+        {
+            particle_step++;
+        }
+    }
+
+    void count_draw_stats()
+    {
+        metrics.draws.add(draw_stats.draws);
+        metrics.pipeline_binds.add(draw_stats.pipeline_binds);
+        metrics.pipeline_binds_skipped.add(draw_stats.pipeline_binds_skipped);
+        metrics.material_binds.add(draw_stats.material_binds);
+        metrics.material_binds_skipped.add(draw_stats.material_binds_skipped);
+        metrics.state_changes_avoided.set(draw_stats.pipeline_binds_skipped + draw_stats.material_binds_skipped);
+    }
+
+    void count_present_result(vk::Result result)
+    {
+        switch (result)
+        {
+        case vk::Result::eSuccess:
+            metrics.present_success.add();
+            break;
+        case vk::Result::eSuboptimalKHR:
+            metrics.present_suboptimal.add();
+            break;
+        case vk::Result::eErrorOutOfDateKHR:
+            metrics.present_out_of_date.add();
+            break;
+        default:
+            metrics.present_error.add();
+            break;
+        }
     }
 
     void cleanup()
@@ -922,32 +3339,101 @@ class LearnVulkanApp
             exit(EXIT_FAILURE);
         }
 
-        device.destroySemaphore(sem_render_finished);
-        device.destroySemaphore(sem_image_available);
+        stop_texture_streaming();
+        simulation.stop();
+        culler.destroy();
+        metrics_server.stop();
+        capture.close();
+
+        for (const auto &target : windows)
+        {
+            device.destroySemaphore(target.sem_render_finished);
+            device.destroySemaphore(target.sem_image_available);
+        }
         device.destroyFence(fence_in_flight);
 
         device.destroyCommandPool(command_pool);
 
-        for (auto fb : swapchain_framebuffers)
+        if (particle_count > 0)
+        {
+            for (uint32_t i = 0; i < 2; i++)
+            {
+                device.destroySemaphore(sem_particles_simulated[i]);
+                device.destroySemaphore(sem_particles_drawn[i]);
+                device.destroyBuffer(particle_buffers[i]);
+                free_device_memory(particle_buffer_memory[i]);
+            }
+            device.destroyCommandPool(compute_command_pool);
+            device.destroyDescriptorPool(particle_descriptor_pool);
+            if (particle_query_pool)
+            {
+                device.destroyQueryPool(particle_query_pool);
+            }
+            device.destroyPipeline(particle_draw_pipeline);
+            device.destroyPipelineLayout(particle_draw_layout);
+            device.destroyPipeline(particle_sim_pipeline);
+            device.destroyPipelineLayout(particle_sim_layout);
+            device.destroyDescriptorSetLayout(particle_set_layout);
+        }
+
+        if (staging_ring_buffer)
+        {
+            device.destroyBuffer(staging_ring_buffer);
+            free_device_memory(staging_ring_memory);
+        }
+
+        device.destroyBuffer(uniform_buffer);
+        free_device_memory(uniform_buffer_memory);
+
+        device.destroyDescriptorPool(descriptor_pool);
+        device.destroySampler(texture_sampler);
+        device.destroyImageView(texture.view);
+        device.destroyImage(texture.image);
+        free_device_memory(texture.memory);
+
+        device.destroyBuffer(index_buffer);
+        free_device_memory(index_buffer_memory);
+        device.destroyBuffer(vertex_buffer);
+        free_device_memory(vertex_buffer_memory);
+
+        for (const auto &target : windows)
         {
-            device.destroyFramebuffer(fb);
+            device.destroyFramebuffer(target.framebuffer);
+            device.destroyImageView(target.depth_view);
+            device.destroyImage(target.depth_image);
+            free_device_memory(target.depth_memory);
+            device.destroyImageView(target.render_view);
+            device.destroyImage(target.render_image);
+            free_device_memory(target.render_memory);
         }
 
-        device.destroyPipeline(graphics_pipeline);
+        if (timestamp_query_pool)
+        {
+            device.destroyQueryPool(timestamp_query_pool);
+        }
+
+        pipeline_manager.destroy();
+        device.destroyShaderModule(shader_program.vert_module);
+        device.destroyShaderModule(shader_program.frag_module);
         device.destroyPipelineLayout(pipeline_layout);
+        device.destroyDescriptorSetLayout(uniform_set_layout);
+        device.destroyDescriptorSetLayout(descriptor_set_layout);
         device.destroyRenderPass(render_pass);
 
-        for (auto image_view : swapchain_image_views)
+        for (const auto &target : windows)
         {
-            device.destroyImageView(image_view);
+            device.destroySwapchainKHR(target.swapchain);
         }
 
-        device.destroySwapchainKHR(swapchain);
-        instance.destroySurfaceKHR(surface);
         device.destroy();
-        instance.destroy();
 
-        glfwDestroyWindow(window);
+        for (const auto &target : windows)
+        {
+            instance.destroySurfaceKHR(target.surface);
+            glfwDestroyWindow(target.window);
+        }
+
+        instance.destroy();
         glfwTerminate();
     }
 };
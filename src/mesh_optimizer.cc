@@ -0,0 +1,487 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+
+// cache size assumed by the Forsyth scoring, larger than the simulated FIFO on purpose
+const uint32_t FORSYTH_CACHE_SIZE = 32;
+
+float forsyth_vertex_score(int cache_position, uint32_t live_triangles)
+{
+    if (live_triangles == 0)
+    {
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if (cache_position >= 0)
+    {
+        if (cache_position < 3)
+        {
+            // the last triangle's vertices are penalized to avoid strips
+            score = 0.75f;
+        }
+        else
+        {
+            float scaler = 1.0f / float(FORSYTH_CACHE_SIZE - 3);
+            score = std::pow(1.0f - float(cache_position - 3) * scaler, 1.5f);
+        }
+    }
+
+    // boost vertices with few remaining triangles so they get finished off
+    return score + 2.0f * std::pow(float(live_triangles), -0.5f);
+}
+
+struct Vec3
+{
+    float x, y, z;
+};
+
+Vec3 sub(Vec3 a, Vec3 b)
+{
+    return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+Vec3 cross(Vec3 a, Vec3 b)
+{
+    return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+float dot(Vec3 a, Vec3 b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+Vec3 position_of(const MeshVertex &vertex)
+{
+    return {vertex.position[0], vertex.position[1], vertex.position[2]};
+}
+
+int16_t to_snorm16(float value)
+{
+    value = std::clamp(value, -1.0f, 1.0f);
+    return int16_t(std::lround(value * 32767.0f));
+}
+
+uint8_t to_unorm8(float value)
+{
+    value = std::clamp(value, 0.0f, 1.0f);
+    return uint8_t(std::lround(value * 255.0f));
+}
+
+} // namespace
+
+VertexCacheStats analyze_vertex_cache(const std::vector<uint32_t> &indices, size_t vertex_count, uint32_t cache_size)
+{
+    VertexCacheStats stats{};
+    if (indices.empty() || vertex_count == 0)
+    {
+        return stats;
+    }
+
+    // FIFO cache, timestamps tell whether a vertex is still within the last cache_size misses
+    std::vector<uint32_t> timestamps(vertex_count, 0);
+    uint32_t time = cache_size + 1;
+    uint32_t misses = 0;
+
+    for (uint32_t index : indices)
+    {
+        if (time - timestamps[index] > cache_size)
+        {
+            timestamps[index] = time++;
+            misses++;
+        }
+    }
+
+    std::vector<bool> referenced(vertex_count, false);
+    size_t unique = 0;
+    for (uint32_t index : indices)
+    {
+        if (!referenced[index])
+        {
+            referenced[index] = true;
+            unique++;
+        }
+    }
+
+    stats.acmr = float(misses) / float(indices.size() / 3);
+    stats.atvr = float(misses) / float(unique);
+    return stats;
+}
+
+void optimize_vertex_cache(std::vector<uint32_t> &indices, size_t vertex_count)
+{
+    const size_t triangle_count = indices.size() / 3;
+    if (triangle_count == 0)
+    {
+        return;
+    }
+
+    // per-vertex lists of triangles that have not been emitted yet
+    std::vector<uint32_t> live_triangles(vertex_count, 0);
+    for (uint32_t index : indices)
+    {
+        live_triangles[index]++;
+    }
+
+    std::vector<uint32_t> adjacency_offsets(vertex_count + 1, 0);
+    for (size_t v = 0; v < vertex_count; v++)
+    {
+        adjacency_offsets[v + 1] = adjacency_offsets[v] + live_triangles[v];
+    }
+
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+    for (size_t t = 0; t < triangle_count; t++)
+    {
+        for (size_t k = 0; k < 3; k++)
+        {
+            adjacency[fill[indices[t * 3 + k]]++] = uint32_t(t);
+        }
+    }
+
+    std::vector<int> cache_position(vertex_count, -1);
+    std::vector<float> vertex_score(vertex_count);
+    for (size_t v = 0; v < vertex_count; v++)
+    {
+        vertex_score[v] = forsyth_vertex_score(-1, live_triangles[v]);
+    }
+
+    std::vector<float> triangle_score(triangle_count);
+    for (size_t t = 0; t < triangle_count; t++)
+    {
+        triangle_score[t] =
+            vertex_score[indices[t * 3 + 0]] + vertex_score[indices[t * 3 + 1]] + vertex_score[indices[t * 3 + 2]];
+    }
+
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> new_cache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    new_cache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+
+    int64_t best = std::max_element(triangle_score.begin(), triangle_score.end()) - triangle_score.begin();
+    size_t cursor = 0;
+
+    while (result.size() < indices.size())
+    {
+        if (best < 0)
+        {
+            // nothing in the cache has live triangles left, restart from the next unemitted triangle
+            while (emitted[cursor])
+            {
+                cursor++;
+            }
+            best = int64_t(cursor);
+        }
+
+        const uint32_t *triangle = &indices[size_t(best) * 3];
+        emitted[size_t(best)] = true;
+        result.insert(result.end(), triangle, triangle + 3);
+
+        for (size_t k = 0; k < 3; k++)
+        {
+            uint32_t v = triangle[k];
+            uint32_t *begin = &adjacency[adjacency_offsets[v]];
+            uint32_t *end = begin + live_triangles[v];
+            uint32_t *it = std::find(begin, end, uint32_t(best));
+            std::swap(*it, *(end - 1));
+            live_triangles[v]--;
+        }
+
+        // most recently used first; vertices pushed past the end fall out of the cache
+        new_cache.clear();
+        for (size_t k = 0; k < 3; k++)
+        {
+            if (std::find(new_cache.begin(), new_cache.end(), triangle[k]) == new_cache.end())
+            {
+                new_cache.push_back(triangle[k]);
+            }
+        }
+        for (uint32_t v : cache)
+        {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+            {
+                new_cache.push_back(v);
+            }
+        }
+
+        for (size_t i = 0; i < new_cache.size(); i++)
+        {
+            uint32_t v = new_cache[i];
+            cache_position[v] = i < FORSYTH_CACHE_SIZE ? int(i) : -1;
+            vertex_score[v] = forsyth_vertex_score(cache_position[v], live_triangles[v]);
+        }
+
+        best = -1;
+        float best_score = -std::numeric_limits<float>::max();
+        for (uint32_t v : new_cache)
+        {
+            for (uint32_t i = 0; i < live_triangles[v]; i++)
+            {
+                uint32_t t = adjacency[adjacency_offsets[v] + i];
+                const uint32_t *tri = &indices[size_t(t) * 3];
+                triangle_score[t] = vertex_score[tri[0]] + vertex_score[tri[1]] + vertex_score[tri[2]];
+                if (triangle_score[t] > best_score)
+                {
+                    best_score = triangle_score[t];
+                    best = t;
+                }
+            }
+        }
+
+        if (new_cache.size() > FORSYTH_CACHE_SIZE)
+        {
+            new_cache.resize(FORSYTH_CACHE_SIZE);
+        }
+        cache.swap(new_cache);
+    }
+
+    indices.swap(result);
+}
+
+void optimize_overdraw(std::vector<uint32_t> &indices, const std::vector<MeshVertex> &vertices, float threshold)
+{
+    const size_t triangle_count = indices.size() / 3;
+    if (triangle_count == 0)
+    {
+        return;
+    }
+
+    const uint32_t cache_size = 16;
+    VertexCacheStats before = analyze_vertex_cache(indices, vertices.size(), cache_size);
+
+    // split the cache-optimized order into clusters wherever a triangle misses on all three vertices,
+    // reordering whole clusters keeps most of the cache locality
+    std::vector<uint32_t> cluster_starts;
+    std::vector<uint32_t> timestamps(vertices.size(), 0);
+    uint32_t time = cache_size + 1;
+    for (size_t t = 0; t < triangle_count; t++)
+    {
+        uint32_t misses = 0;
+        for (size_t k = 0; k < 3; k++)
+        {
+            uint32_t v = indices[t * 3 + k];
+            if (time - timestamps[v] > cache_size)
+            {
+                timestamps[v] = time++;
+                misses++;
+            }
+        }
+
+        if (t == 0 || misses == 3)
+        {
+            cluster_starts.push_back(uint32_t(t));
+        }
+    }
+    cluster_starts.push_back(uint32_t(triangle_count));
+
+    const size_t cluster_count = cluster_starts.size() - 1;
+    if (cluster_count < 2)
+    {
+        return;
+    }
+
+    Vec3 mesh_centroid{0.0f, 0.0f, 0.0f};
+    float mesh_area = 0.0f;
+    std::vector<Vec3> cluster_centroids(cluster_count);
+    std::vector<Vec3> cluster_normals(cluster_count);
+
+    for (size_t c = 0; c < cluster_count; c++)
+    {
+        Vec3 centroid{0.0f, 0.0f, 0.0f};
+        Vec3 normal{0.0f, 0.0f, 0.0f};
+        float area = 0.0f;
+
+        for (uint32_t t = cluster_starts[c]; t < cluster_starts[c + 1]; t++)
+        {
+            Vec3 p0 = position_of(vertices[indices[t * 3 + 0]]);
+            Vec3 p1 = position_of(vertices[indices[t * 3 + 1]]);
+            Vec3 p2 = position_of(vertices[indices[t * 3 + 2]]);
+
+            // area-weighted: the cross product length is twice the triangle area
+            Vec3 n = cross(sub(p1, p0), sub(p2, p0));
+            float a = std::sqrt(dot(n, n));
+
+            centroid.x += (p0.x + p1.x + p2.x) * a / 3.0f;
+            centroid.y += (p0.y + p1.y + p2.y) * a / 3.0f;
+            centroid.z += (p0.z + p1.z + p2.z) * a / 3.0f;
+            normal.x += n.x;
+            normal.y += n.y;
+            normal.z += n.z;
+            area += a;
+        }
+
+        mesh_centroid.x += centroid.x;
+        mesh_centroid.y += centroid.y;
+        mesh_centroid.z += centroid.z;
+        mesh_area += area;
+
+        float inv_area = area > 0.0f ? 1.0f / area : 0.0f;
+        cluster_centroids[c] = {centroid.x * inv_area, centroid.y * inv_area, centroid.z * inv_area};
+
+        float length = std::sqrt(dot(normal, normal));
+        float inv_length = length > 0.0f ? 1.0f / length : 0.0f;
+        cluster_normals[c] = {normal.x * inv_length, normal.y * inv_length, normal.z * inv_length};
+    }
+
+    float inv_mesh_area = mesh_area > 0.0f ? 1.0f / mesh_area : 0.0f;
+    mesh_centroid = {mesh_centroid.x * inv_mesh_area, mesh_centroid.y * inv_mesh_area,
+                     mesh_centroid.z * inv_mesh_area};
+
+    // clusters facing away from the mesh center are likely to occlude the rest, draw them first
+    std::vector<float> sort_keys(cluster_count);
+    for (size_t c = 0; c < cluster_count; c++)
+    {
+        sort_keys[c] = dot(sub(cluster_centroids[c], mesh_centroid), cluster_normals[c]);
+    }
+
+    std::vector<uint32_t> order(cluster_count);
+    for (size_t c = 0; c < cluster_count; c++)
+    {
+        order[c] = uint32_t(c);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sort_keys[a] > sort_keys[b]; });
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (uint32_t c : order)
+    {
+        result.insert(result.end(), indices.begin() + size_t(cluster_starts[c]) * 3,
+                      indices.begin() + size_t(cluster_starts[c + 1]) * 3);
+    }
+
+    VertexCacheStats after = analyze_vertex_cache(result, vertices.size(), cache_size);
+    if (after.acmr <= before.acmr * threshold)
+    {
+        indices.swap(result);
+    }
+}
+
+void optimize_vertex_fetch(std::vector<uint32_t> &indices, std::vector<MeshVertex> &vertices)
+{
+    std::vector<uint32_t> remap(vertices.size(), std::numeric_limits<uint32_t>::max());
+    std::vector<MeshVertex> result;
+    result.reserve(vertices.size());
+
+    for (uint32_t &index : indices)
+    {
+        if (remap[index] == std::numeric_limits<uint32_t>::max())
+        {
+            remap[index] = uint32_t(result.size());
+            result.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices.swap(result);
+}
+
+std::vector<PackedVertex> quantize_vertices(const std::vector<MeshVertex> &vertices)
+{
+    std::vector<PackedVertex> result(vertices.size());
+
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        const MeshVertex &in = vertices[i];
+        PackedVertex &out = result[i];
+
+        out.position[0] = float_to_half(in.position[0]);
+        out.position[1] = float_to_half(in.position[1]);
+        out.position[2] = float_to_half(in.position[2]);
+        out.position[3] = float_to_half(1.0f);
+
+        // project onto the octahedron |x| + |y| + |z| = 1 and fold the lower hemisphere over the diagonals
+        float nx = in.normal[0];
+        float ny = in.normal[1];
+        float nz = in.normal[2];
+        float l1 = std::fabs(nx) + std::fabs(ny) + std::fabs(nz);
+        if (l1 == 0.0f)
+        {
+            nx = 0.0f;
+            ny = 0.0f;
+            nz = 1.0f;
+            l1 = 1.0f;
+        }
+        nx /= l1;
+        ny /= l1;
+        nz /= l1;
+
+        if (nz < 0.0f)
+        {
+            float fx = (1.0f - std::fabs(ny)) * (nx >= 0.0f ? 1.0f : -1.0f);
+            float fy = (1.0f - std::fabs(nx)) * (ny >= 0.0f ? 1.0f : -1.0f);
+            nx = fx;
+            ny = fy;
+        }
+
+        out.normal[0] = to_snorm16(nx);
+        out.normal[1] = to_snorm16(ny);
+
+        for (size_t c = 0; c < 4; c++)
+        {
+            out.color[c] = to_unorm8(in.color[c]);
+        }
+    }
+
+    return result;
+}
+
+uint16_t float_to_half(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t float_exponent = (bits >> 23) & 0xff;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (float_exponent == 0xff)
+    {
+        // inf or nan
+        return uint16_t(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+    }
+
+    int32_t exponent = int32_t(float_exponent) - 127 + 15;
+    if (exponent >= 31)
+    {
+        return uint16_t(sign | 0x7c00);
+    }
+
+    if (exponent <= 0)
+    {
+        if (exponent < -10)
+        {
+            return uint16_t(sign);
+        }
+
+        // subnormal half, round to nearest even
+        mantissa |= 0x800000;
+        uint32_t shift = uint32_t(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t midpoint = 1u << (shift - 1);
+        if (remainder > midpoint || (remainder == midpoint && (half & 1)))
+        {
+            half++;
+        }
+        return uint16_t(sign | half);
+    }
+
+    // round to nearest even, a carry out of the mantissa correctly bumps the exponent
+    uint32_t half = sign | (uint32_t(exponent) << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fff;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+    {
+        half++;
+    }
+    return uint16_t(half);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// full precision vertex as produced by mesh generation/loading
+struct MeshVertex
+{
+    float position[3];
+    float normal[3];
+    float color[4];
+};
+
+// quantized vertex as consumed by tri.vert, see create_graphics_pipeline()
+struct PackedVertex
+{
+    uint16_t position[4]; // half floats, w is 1.0
+    int16_t normal[2];    // octahedral encoding, snorm
+    uint8_t color[4];     // unorm
+};
+
+struct VertexCacheStats
+{
+    float acmr; // average cache miss ratio, transformed vertices per triangle
+    float atvr; // average transformed vertex ratio, transformed vertices per unique vertex
+};
+
+// simulates a FIFO post-transform cache of the given size
+VertexCacheStats analyze_vertex_cache(const std::vector<uint32_t> &indices, size_t vertex_count,
+                                      uint32_t cache_size = 16);
+
+// reorders triangles for post-transform cache locality (Forsyth, "Linear-Speed Vertex Cache Optimisation")
+void optimize_vertex_cache(std::vector<uint32_t> &indices, size_t vertex_count);
+
+// reorders cache-optimized clusters of triangles outside-in to reduce overdraw, keeping the ACMR within
+// threshold times the input ACMR
+void optimize_overdraw(std::vector<uint32_t> &indices, const std::vector<MeshVertex> &vertices,
+                       float threshold = 1.05f);
+
+// reorders vertices in first-use order and drops unreferenced ones, remapping indices
+void optimize_vertex_fetch(std::vector<uint32_t> &indices, std::vector<MeshVertex> &vertices);
+
+std::vector<PackedVertex> quantize_vertices(const std::vector<MeshVertex> &vertices);
+
+uint16_t float_to_half(float value);
@@ -0,0 +1,237 @@
+#include "metrics.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+
+uint64_t load(const std::atomic<uint64_t> &value)
+{
+    return value.load(std::memory_order_relaxed);
+}
+
+void write_counter(std::ostringstream &out, const char *name, const char *help, const Counter &counter)
+{
+    out << "# HELP " << name << " " << help << "\n";
+    out << "# TYPE " << name << " counter\n";
+    out << name << " " << load(counter.value) << "\n";
+}
+
+void write_gauge(std::ostringstream &out, const char *name, const char *help, const Gauge &gauge)
+{
+    out << "# HELP " << name << " " << help << "\n";
+    out << "# TYPE " << name << " gauge\n";
+    out << name << " " << gauge.value.load(std::memory_order_relaxed) << "\n";
+}
+
+// one gauge per memory heap, labelled with the heap index
+void write_heap_gauges(std::ostringstream &out, const char *name, const char *help, const Gauge *gauges,
+                       uint32_t heap_count)
+{
+    out << "# HELP " << name << " " << help << "\n";
+    out << "# TYPE " << name << " gauge\n";
+    for (uint32_t i = 0; i < heap_count; i++)
+    {
+        out << name << "{heap=\"" << i << "\"} " << gauges[i].value.load(std::memory_order_relaxed) << "\n";
+    }
+}
+
+void write_histogram(std::ostringstream &out, const char *name, const char *help, const Histogram &histogram)
+{
+    out << "# HELP " << name << " " << help << "\n";
+    out << "# TYPE " << name << " histogram\n";
+
+    // buckets are cumulative in the exposition format
+    uint64_t cumulative = 0;
+    for (int i = 0; i < Histogram::BUCKET_COUNT - 1; i++)
+    {
+        cumulative += load(histogram.buckets[i]);
+        out << name << "_bucket{le=\"" << (1ull << i) << "\"} " << cumulative << "\n";
+    }
+    cumulative += load(histogram.buckets[Histogram::BUCKET_COUNT - 1]);
+    out << name << "_bucket{le=\"+Inf\"} " << cumulative << "\n";
+    out << name << "_sum " << load(histogram.sum) << "\n";
+    out << name << "_count " << load(histogram.count) << "\n";
+}
+
+} // namespace
+
+std::string format_metrics(const RenderMetrics &metrics)
+{
+    std::ostringstream out;
+
+    write_counter(out, "learn_vulkan_frames_total", "Frames drawn.", metrics.frames);
+    write_counter(out, "learn_vulkan_queue_submits_total", "Calls to vkQueueSubmit.", metrics.queue_submits);
+
+    out << "# HELP learn_vulkan_presents_total Results of vkQueuePresentKHR.\n";
+    out << "# TYPE learn_vulkan_presents_total counter\n";
+    out << "learn_vulkan_presents_total{result=\"success\"} " << load(metrics.present_success.value) << "\n";
+    out << "learn_vulkan_presents_total{result=\"suboptimal\"} " << load(metrics.present_suboptimal.value) << "\n";
+    out << "learn_vulkan_presents_total{result=\"out_of_date\"} " << load(metrics.present_out_of_date.value) << "\n";
+    out << "learn_vulkan_presents_total{result=\"error\"} " << load(metrics.present_error.value) << "\n";
+
+    write_histogram(out, "learn_vulkan_frame_time_us", "Time between frame starts.", metrics.frame_time_us);
+    write_histogram(out, "learn_vulkan_fence_wait_us", "Time waiting for the in flight fence.", metrics.fence_wait_us);
+    write_histogram(out, "learn_vulkan_acquire_wait_us", "Time in vkAcquireNextImageKHR.", metrics.acquire_wait_us);
+    write_histogram(out, "learn_vulkan_record_us", "Time recording command buffers.", metrics.record_us);
+    write_histogram(out, "learn_vulkan_submit_us", "Time in vkQueueSubmit.", metrics.submit_us);
+    write_histogram(out, "learn_vulkan_present_us", "Time in vkQueuePresentKHR.", metrics.present_us);
+    write_histogram(out, "learn_vulkan_gpu_render_us", "GPU time of the render passes.", metrics.gpu_render_us);
+    write_gauge(out, "learn_vulkan_render_scale_percent", "Internal resolution relative to the window.",
+                metrics.render_scale_percent);
+    write_histogram(out, "learn_vulkan_cull_us", "Time culling instances against the frustum.", metrics.cull_us);
+    write_gauge(out, "learn_vulkan_instances", "Instances in the scene.", metrics.instances);
+    write_gauge(out, "learn_vulkan_visible_instances", "Instances that passed frustum culling.",
+                metrics.visible_instances);
+    write_counter(out, "learn_vulkan_sim_ticks_total", "Simulation ticks.", metrics.sim_ticks);
+    write_histogram(out, "learn_vulkan_sim_tick_us", "Time per simulation tick.", metrics.sim_tick_us);
+    write_counter(out, "learn_vulkan_stale_snapshots_total", "Frames drawn without a new simulation snapshot.",
+                  metrics.stale_snapshots);
+
+    write_counter(out, "learn_vulkan_draws_total", "Draw calls recorded.", metrics.draws);
+    write_counter(out, "learn_vulkan_draws_capped_total",
+                  "Visible instances not drawn because the frame's uniform ring was full.", metrics.draws_capped);
+
+    out << "# HELP learn_vulkan_binds_total State binds while recording draws, skipped ones were redundant.\n";
+    out << "# TYPE learn_vulkan_binds_total counter\n";
+    out << "learn_vulkan_binds_total{state=\"pipeline\",result=\"issued\"} " << load(metrics.pipeline_binds.value)
+        << "\n";
+    out << "learn_vulkan_binds_total{state=\"pipeline\",result=\"skipped\"} "
+        << load(metrics.pipeline_binds_skipped.value) << "\n";
+    out << "learn_vulkan_binds_total{state=\"material\",result=\"issued\"} " << load(metrics.material_binds.value)
+        << "\n";
+    out << "learn_vulkan_binds_total{state=\"material\",result=\"skipped\"} "
+        << load(metrics.material_binds_skipped.value) << "\n";
+
+    write_gauge(out, "learn_vulkan_state_changes_avoided", "Redundant binds skipped in the last frame.",
+                metrics.state_changes_avoided);
+    write_gauge(out, "learn_vulkan_uniform_bytes", "Bytes of draw uniforms written in the last frame.",
+                metrics.uniform_bytes);
+
+    write_gauge(out, "learn_vulkan_particles", "Particles simulated and drawn every frame.", metrics.particles);
+    write_counter(out, "learn_vulkan_particles_simulated_total", "Particle updates run on the compute queue.",
+                  metrics.particles_simulated);
+    write_histogram(out, "learn_vulkan_particle_sim_us", "GPU time of a particle simulation step.",
+                    metrics.particle_sim_us);
+    write_gauge(out, "learn_vulkan_particles_per_second",
+                "Simulation throughput of the last measured step, in particles per GPU second.",
+                metrics.particles_per_second);
+
+    uint32_t heap_count = metrics.heap_count.load(std::memory_order_relaxed);
+
+    write_heap_gauges(out, "learn_vulkan_heap_size_bytes", "Size of each device memory heap.",
+                      metrics.heap_size_bytes, heap_count);
+    write_heap_gauges(out, "learn_vulkan_heap_allocated_bytes",
+                      "Device memory allocated by the application per heap.", metrics.heap_allocated_bytes,
+                      heap_count);
+    write_heap_gauges(out, "learn_vulkan_heap_usage_bytes",
+                      "Device memory used by the process per heap, from VK_EXT_memory_budget when available.",
+                      metrics.heap_usage_bytes, heap_count);
+    write_heap_gauges(out, "learn_vulkan_heap_budget_bytes",
+                      "Device memory the process can use per heap before the driver evicts or fails allocations.",
+                      metrics.heap_budget_bytes, heap_count);
+    write_counter(out, "learn_vulkan_memory_evictions_total",
+                  "Resources released or downgraded because a heap neared its budget.", metrics.memory_evictions);
+    write_counter(out, "learn_vulkan_memory_evictions_exhausted_total",
+                  "Budget checks that found a heap near its budget with nothing left to evict.",
+                  metrics.memory_evictions_exhausted);
+
+    return out.str();
+}
+
+bool MetricsServer::start(const std::string &socket_path, const RenderMetrics *metrics)
+{
+    this->metrics = metrics;
+    this->socket_path = socket_path;
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path))
+    {
+        std::cerr << "metrics: socket path too long: " << socket_path << std::endl;
+        return false;
+    }
+    strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0)
+    {
+        std::cerr << "metrics: failed to create socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // a stale socket from a previous run would make bind fail
+    unlink(socket_path.c_str());
+
+    if (bind(listen_fd, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd, 4) < 0)
+    {
+        std::cerr << "metrics: failed to listen on " << socket_path << ": " << strerror(errno) << std::endl;
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+
+    std::cerr << "metrics: serving on " << socket_path << std::endl;
+
+    stopping.store(false);
+    thread = std::thread(&MetricsServer::serve, this);
+    return true;
+}
+
+void MetricsServer::stop()
+{
+    if (listen_fd < 0)
+    {
+        return;
+    }
+
+    stopping.store(true);
+    thread.join();
+
+    close(listen_fd);
+    listen_fd = -1;
+    unlink(socket_path.c_str());
+}
+
+void MetricsServer::serve()
+{
+    while (!stopping.load())
+    {
+        // wake up regularly to notice stop()
+        pollfd pfd{};
+        pfd.fd = listen_fd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, 100) <= 0)
+        {
+            continue;
+        }
+
+        int client_fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client_fd < 0)
+        {
+            continue;
+        }
+
+        std::string text = format_metrics(*metrics);
+        size_t written = 0;
+        while (written < text.size())
+        {
+            ssize_t n = send(client_fd, text.data() + written, text.size() - written, MSG_NOSIGNAL);
+            if (n <= 0)
+            {
+                break;
+            }
+            written += (size_t)n;
+        }
+
+        close(client_fd);
+    }
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+// all updates are relaxed atomics, a reader may see a histogram mid-update which is fine for monitoring
+struct Counter
+{
+    std::atomic<uint64_t> value{0};
+
+    void add(uint64_t n = 1)
+    {
+        value.fetch_add(n, std::memory_order_relaxed);
+    }
+};
+
+struct Gauge
+{
+    std::atomic<int64_t> value{0};
+
+    void set(int64_t v)
+    {
+        value.store(v, std::memory_order_relaxed);
+    }
+
+    void add(int64_t n)
+    {
+        value.fetch_add(n, std::memory_order_relaxed);
+    }
+};
+
+// power of two buckets, bucket i counts observations <= 2^i, the last one everything above
+struct Histogram
+{
+    static const int BUCKET_COUNT = 24;
+
+    std::atomic<uint64_t> buckets[BUCKET_COUNT]{};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum{0};
+
+    void observe(uint64_t value)
+    {
+        int bucket = value <= 1 ? 0 : 64 - __builtin_clzll(value - 1);
+        if (bucket >= BUCKET_COUNT)
+        {
+            bucket = BUCKET_COUNT - 1;
+        }
+
+        buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(value, std::memory_order_relaxed);
+    }
+};
+
+const int METRICS_MAX_HEAPS = 16; // VK_MAX_MEMORY_HEAPS
+
+struct RenderMetrics
+{
+    Counter frames;
+    Counter queue_submits;
+    Counter present_success;
+    Counter present_suboptimal;
+    Counter present_out_of_date;
+    Counter present_error;
+
+    // draw_frame() phases, in microseconds
+    Histogram frame_time_us;
+    Histogram fence_wait_us;
+    Histogram acquire_wait_us;
+    Histogram record_us;
+    Histogram submit_us;
+    Histogram present_us;
+
+    // render passes of every window, from timestamp queries
+    Histogram gpu_render_us;
+    Gauge render_scale_percent;
+
+    Histogram cull_us;
+    Gauge instances;
+    Gauge visible_instances;
+
+    Counter sim_ticks;
+    Histogram sim_tick_us;
+    Counter stale_snapshots; // frames that reused the previous simulation snapshot
+
+    // binds issued and filtered out while recording the sorted draw list
+    Counter draws;
+    Counter draws_capped; // visible instances left undrawn once the uniform ring was full
+    Counter pipeline_binds;
+    Counter pipeline_binds_skipped;
+    Counter material_binds;
+    Counter material_binds_skipped;
+    Gauge state_changes_avoided; // last frame
+    Gauge uniform_bytes;         // written to the uniform ring in the last frame
+
+    // particles.comp on the compute queue
+    Gauge particles;
+    Counter particles_simulated;
+    Histogram particle_sim_us;  // GPU time per step, from timestamp queries
+    Gauge particles_per_second; // particles over the GPU time of the last measured step
+
+    std::atomic<uint32_t> heap_count{0};
+    Gauge heap_size_bytes[METRICS_MAX_HEAPS];
+    Gauge heap_allocated_bytes[METRICS_MAX_HEAPS]; // allocated by the app
+    Gauge heap_usage_bytes[METRICS_MAX_HEAPS];     // by the whole process, sampled every few frames
+    Gauge heap_budget_bytes[METRICS_MAX_HEAPS];
+    Counter memory_evictions;           // steps of the eviction policy taken because a heap neared its budget
+    Counter memory_evictions_exhausted; // budget checks that found a heap over the mark with nothing left to evict
+};
+
+// Prometheus text exposition format
+std::string format_metrics(const RenderMetrics &metrics);
+
+// serves format_metrics() to every client that connects to a Unix domain socket, then closes the connection
+class MetricsServer
+{
+  public:
+    // logs and returns false if the socket cannot be set up, rendering continues without metrics
+    bool start(const std::string &socket_path, const RenderMetrics *metrics);
+
+    void stop();
+
+  private:
+    void serve();
+
+    const RenderMetrics *metrics = nullptr;
+    std::string socket_path;
+    int listen_fd = -1;
+    std::thread thread;
+    std::atomic<bool> stopping{false};
+};
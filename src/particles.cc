@@ -0,0 +1,37 @@
+#include "particles.h"
+
+#include <cmath>
+
+std::vector<Particle> generate_particles(uint32_t count, float radius, float gravity)
+{
+    std::vector<Particle> particles(count);
+
+    uint32_t state = 1;
+    auto next = [&] {
+        state = state * 1664525u + 1013904223u;
+        return (float)(state >> 8) / (float)(1u << 24);
+    };
+
+    for (Particle &p : particles)
+    {
+        // denser towards the center, never at it where the pull is unbounded
+        float r = radius * (0.05f + 0.95f * std::sqrt(next()));
+        float angle = next() * 6.2831853f;
+        float c = std::cos(angle);
+        float s = std::sin(angle);
+
+        p.position[0] = r * c;
+        p.position[1] = r * s;
+        p.position[2] = (next() * 2.0f - 1.0f) * radius * 0.02f;
+        p.position[3] = 1.0f;
+
+        // speed of a circular orbit, perpendicular to the radius
+        float speed = std::sqrt(gravity / r);
+        p.velocity[0] = -s * speed;
+        p.velocity[1] = c * speed;
+        p.velocity[2] = 0.0f;
+        p.velocity[3] = 0.0f;
+    }
+
+    return particles;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// local_size_x of particles.comp
+const uint32_t PARTICLE_WORKGROUP_SIZE = 256;
+
+// std430 element of the particle storage buffers, also read per vertex by particles.vert
+struct Particle
+{
+    float position[4]; // w unused
+    float velocity[4]; // w unused
+};
+
+// push constants of particles.comp
+struct ParticleSimParams
+{
+    float dt;
+    float gravity; // strength of the pull towards the origin
+    uint32_t count;
+    uint32_t padding;
+};
+
+// push constants of particles.vert
+struct ParticleDrawParams
+{
+    float view_projection[16]; // column major
+};
+
+// a thin disk of particles on circular orbits around the origin, fixed seed so runs are comparable
+std::vector<Particle> generate_particles(uint32_t count, float radius, float gravity);
@@ -0,0 +1,542 @@
+#include "pipelines.h"
+#include "mesh_optimizer.h"
+#include "particles.h"
+
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+uint64_t hash_bytes(const void *data, size_t size, uint64_t seed)
+{
+    // FNV-1a
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t hash_pipeline(const ShaderProgram &program, const PipelineKey &key)
+{
+    // field by field, the key has padding
+    uint32_t state[] = {
+        static_cast<VkCullModeFlags>(key.cull_mode),
+        (uint32_t)key.front_face,
+        (uint32_t)key.polygon_mode,
+        (uint32_t)key.blend_enable,
+        key.frag_specialization.use_texture,
+        key.frag_specialization.desaturate,
+    };
+    return hash_bytes(state, sizeof(state), hash_bytes(&program.hash, sizeof(program.hash)));
+}
+
+vk::Format find_depth_format(vk::PhysicalDevice physical_device)
+{
+    const vk::Format candidates[] = {vk::Format::eD32Sfloat, vk::Format::eD32SfloatS8Uint,
+                                     vk::Format::eD24UnormS8Uint};
+    for (vk::Format format : candidates)
+    {
+        vk::FormatProperties properties = physical_device.getFormatProperties(format);
+        if (properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eDepthStencilAttachment)
+        {
+            return format;
+        }
+    }
+    return vk::Format::eUndefined;
+}
+
+vk::DescriptorSetLayout create_descriptor_set_layout(vk::Device device)
+{
+    vk::DescriptorSetLayoutBinding sampler_binding{};
+    sampler_binding.binding = 0;
+    sampler_binding.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+    sampler_binding.descriptorCount = 1;
+    sampler_binding.stageFlags = vk::ShaderStageFlagBits::eFragment;
+
+    vk::DescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.setBindings(sampler_binding);
+
+    auto res = device.createDescriptorSetLayout(layout_info);
+    if (res.result != vk::Result::eSuccess)
+    {
+        std::cerr << "failed to create descriptor set layout" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    return res.value;
+}
+
+vk::DescriptorSetLayout create_uniform_set_layout(vk::Device device)
+{
+    vk::DescriptorSetLayoutBinding uniform_binding{};
+    uniform_binding.binding = 0;
+    uniform_binding.descriptorType = vk::DescriptorType::eUniformBufferDynamic;
+    uniform_binding.descriptorCount = 1;
+    uniform_binding.stageFlags = vk::ShaderStageFlagBits::eVertex;
+
+    vk::DescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.setBindings(uniform_binding);
+
+    auto res = device.createDescriptorSetLayout(layout_info);
+    if (res.result != vk::Result::eSuccess)
+    {
+        std::cerr << "failed to create uniform descriptor set layout" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    return res.value;
+}
+
+vk::PipelineLayout create_pipeline_layout(vk::Device device, vk::DescriptorSetLayout set_layout,
+                                          vk::DescriptorSetLayout uniform_set_layout)
+{
+    vk::DescriptorSetLayout set_layouts[2] = {set_layout, uniform_set_layout};
+
+    vk::PushConstantRange push_constant_range{};
+    push_constant_range.stageFlags = vk::ShaderStageFlagBits::eFragment;
+    push_constant_range.offset = 0;
+    push_constant_range.size = sizeof(DrawPushConstants);
+
+    vk::PipelineLayoutCreateInfo pipeline_layout_info{};
+    pipeline_layout_info.setSetLayouts(set_layouts);
+    pipeline_layout_info.setPushConstantRanges(push_constant_range);
+
+    auto res = device.createPipelineLayout(pipeline_layout_info);
+    if (res.result != vk::Result::eSuccess)
+    {
+        std::cerr << "failed to create pipeline layout" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    return res.value;
+}
+
+vk::Pipeline create_pipeline_variant(vk::Device device, vk::PipelineCache cache, vk::RenderPass render_pass,
+                                     vk::PipelineLayout layout, const ShaderProgram &program, const PipelineKey &key)
+{
+    vk::SpecializationMapEntry frag_map_entries[2]{};
+    frag_map_entries[0].constantID = 0;
+    frag_map_entries[0].offset = offsetof(FragmentSpecialization, use_texture);
+    frag_map_entries[0].size = sizeof(uint32_t);
+    frag_map_entries[1].constantID = 1;
+    frag_map_entries[1].offset = offsetof(FragmentSpecialization, desaturate);
+    frag_map_entries[1].size = sizeof(uint32_t);
+
+    vk::SpecializationInfo frag_specialization_info{};
+    frag_specialization_info.setMapEntries(frag_map_entries);
+    frag_specialization_info.dataSize = sizeof(FragmentSpecialization);
+    frag_specialization_info.pData = &key.frag_specialization;
+
+    vk::PipelineShaderStageCreateInfo vert_stage_info{};
+    vert_stage_info.stage = vk::ShaderStageFlagBits::eVertex;
+    vert_stage_info.module = program.vert_module;
+    vert_stage_info.pName = "main";
+
+    vk::PipelineShaderStageCreateInfo frag_stage_info{};
+    frag_stage_info.stage = vk::ShaderStageFlagBits::eFragment;
+    frag_stage_info.module = program.frag_module;
+    frag_stage_info.pName = "main";
+    frag_stage_info.pSpecializationInfo = &frag_specialization_info;
+
+    vk::PipelineShaderStageCreateInfo shader_stages[] = {vert_stage_info, frag_stage_info};
+
+    vk::DynamicState dynamic_states[] = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+    vk::PipelineDynamicStateCreateInfo dynamic_state{};
+    dynamic_state.setDynamicStates(dynamic_states);
+
+    vk::VertexInputBindingDescription binding_description{};
+    binding_description.binding = 0;
+    binding_description.stride = sizeof(PackedVertex);
+    binding_description.inputRate = vk::VertexInputRate::eVertex;
+
+    vk::VertexInputAttributeDescription attribute_descriptions[3]{};
+    attribute_descriptions[0].binding = 0;
+    attribute_descriptions[0].location = 0;
+    attribute_descriptions[0].format = vk::Format::eR16G16B16A16Sfloat;
+    attribute_descriptions[0].offset = offsetof(PackedVertex, position);
+
+    attribute_descriptions[1].binding = 0;
+    attribute_descriptions[1].location = 1;
+    attribute_descriptions[1].format = vk::Format::eR16G16Snorm;
+    attribute_descriptions[1].offset = offsetof(PackedVertex, normal);
+
+    attribute_descriptions[2].binding = 0;
+    attribute_descriptions[2].location = 2;
+    attribute_descriptions[2].format = vk::Format::eR8G8B8A8Unorm;
+    attribute_descriptions[2].offset = offsetof(PackedVertex, color);
+
+    vk::PipelineVertexInputStateCreateInfo vertex_input_info{};
+    vertex_input_info.setVertexBindingDescriptions(binding_description);
+    vertex_input_info.setVertexAttributeDescriptions(attribute_descriptions);
+
+    vk::PipelineInputAssemblyStateCreateInfo input_assembly{};
+    input_assembly.topology = vk::PrimitiveTopology::eTriangleList;
+    input_assembly.primitiveRestartEnable = VK_FALSE;
+
+    // viewport and scissor are dynamic, only the counts matter
+    vk::PipelineViewportStateCreateInfo viewport_state{};
+    viewport_state.viewportCount = 1;
+    viewport_state.scissorCount = 1;
+
+    vk::PipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.depthClampEnable = VK_FALSE;
+    rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    rasterizer.polygonMode = key.polygon_mode;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = key.cull_mode;
+    rasterizer.frontFace = key.front_face;
+    rasterizer.depthBiasEnable = VK_FALSE;
+    rasterizer.depthBiasConstantFactor = 0.0f;
+    rasterizer.depthBiasClamp = 0.0f;
+    rasterizer.depthBiasSlopeFactor = 0.0f;
+
+    vk::PipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sampleShadingEnable = VK_FALSE;
+    multisampling.rasterizationSamples = vk::SampleCountFlagBits::e1;
+    multisampling.minSampleShading = 1.0f;
+    multisampling.pSampleMask = nullptr;
+    multisampling.alphaToCoverageEnable = VK_FALSE;
+    multisampling.alphaToOneEnable = VK_FALSE;
+
+    vk::PipelineColorBlendAttachmentState color_blend_attachment{};
+    color_blend_attachment.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+                                            vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+    if (key.blend_enable)
+    {
+        color_blend_attachment.blendEnable = VK_TRUE;
+        color_blend_attachment.srcColorBlendFactor = vk::BlendFactor::eSrcAlpha;
+        color_blend_attachment.dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
+        color_blend_attachment.colorBlendOp = vk::BlendOp::eAdd;
+        color_blend_attachment.srcAlphaBlendFactor = vk::BlendFactor::eOne;
+        color_blend_attachment.dstAlphaBlendFactor = vk::BlendFactor::eZero;
+        color_blend_attachment.alphaBlendOp = vk::BlendOp::eAdd;
+    }
+    else
+    {
+        color_blend_attachment.blendEnable = VK_FALSE;
+        color_blend_attachment.srcColorBlendFactor = vk::BlendFactor::eOne;
+        color_blend_attachment.dstColorBlendFactor = vk::BlendFactor::eZero;
+        color_blend_attachment.colorBlendOp = vk::BlendOp::eAdd;
+        color_blend_attachment.srcAlphaBlendFactor = vk::BlendFactor::eOne;
+        color_blend_attachment.dstAlphaBlendFactor = vk::BlendFactor::eZero;
+        color_blend_attachment.alphaBlendOp = vk::BlendOp::eAdd;
+    }
+
+    vk::PipelineColorBlendStateCreateInfo color_blending{};
+    color_blending.logicOpEnable = VK_FALSE;
+    color_blending.logicOp = vk::LogicOp::eCopy;
+    color_blending.setAttachments(color_blend_attachment);
+    color_blending.blendConstants[0] = 0.0f;
+    color_blending.blendConstants[1] = 0.0f;
+    color_blending.blendConstants[2] = 0.0f;
+    color_blending.blendConstants[3] = 0.0f;
+
+    // blended draws come after the opaque ones and must not hide each other
+    vk::PipelineDepthStencilStateCreateInfo depth_stencil{};
+    depth_stencil.depthTestEnable = VK_TRUE;
+    depth_stencil.depthWriteEnable = key.blend_enable ? VK_FALSE : VK_TRUE;
+    depth_stencil.depthCompareOp = vk::CompareOp::eLess;
+    depth_stencil.depthBoundsTestEnable = VK_FALSE;
+    depth_stencil.stencilTestEnable = VK_FALSE;
+
+    vk::GraphicsPipelineCreateInfo pipeline_info{};
+    pipeline_info.setStages(shader_stages);
+    pipeline_info.pVertexInputState = &vertex_input_info;
+    pipeline_info.pInputAssemblyState = &input_assembly;
+    pipeline_info.pViewportState = &viewport_state;
+    pipeline_info.pRasterizationState = &rasterizer;
+    pipeline_info.pMultisampleState = &multisampling;
+    pipeline_info.pColorBlendState = &color_blending;
+    pipeline_info.pDepthStencilState = &depth_stencil;
+    pipeline_info.pDynamicState = &dynamic_state;
+    pipeline_info.layout = layout;
+    pipeline_info.renderPass = render_pass;
+    pipeline_info.subpass = 0;
+
+    auto res = device.createGraphicsPipeline(cache, pipeline_info);
+    if (res.result != vk::Result::eSuccess)
+    {
+        std::cerr << "failed to create graphics pipeline: " << vk::to_string(res.result) << std::endl;
+        return nullptr;
+    }
+    return res.value;
+}
+
+vk::DescriptorSetLayout create_particle_set_layout(vk::Device device)
+{
+    vk::DescriptorSetLayoutBinding bindings[2]{};
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = vk::DescriptorType::eStorageBuffer;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = vk::ShaderStageFlagBits::eCompute;
+    }
+
+    vk::DescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.setBindings(bindings);
+
+    auto res = device.createDescriptorSetLayout(layout_info);
+    if (res.result != vk::Result::eSuccess)
+    {
+        std::cerr << "failed to create particle descriptor set layout" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    return res.value;
+}
+
+vk::PipelineLayout create_particle_sim_layout(vk::Device device, vk::DescriptorSetLayout set_layout)
+{
+    vk::PushConstantRange push_constant_range{};
+    push_constant_range.stageFlags = vk::ShaderStageFlagBits::eCompute;
+    push_constant_range.offset = 0;
+    push_constant_range.size = sizeof(ParticleSimParams);
+
+    vk::PipelineLayoutCreateInfo pipeline_layout_info{};
+    pipeline_layout_info.setSetLayouts(set_layout);
+    pipeline_layout_info.setPushConstantRanges(push_constant_range);
+
+    auto res = device.createPipelineLayout(pipeline_layout_info);
+    if (res.result != vk::Result::eSuccess)
+    {
+        std::cerr << "failed to create particle simulation pipeline layout" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    return res.value;
+}
+
+vk::Pipeline create_particle_sim_pipeline(vk::Device device, vk::PipelineLayout layout, vk::ShaderModule module)
+{
+    vk::ComputePipelineCreateInfo pipeline_info{};
+    pipeline_info.stage.stage = vk::ShaderStageFlagBits::eCompute;
+    pipeline_info.stage.module = module;
+    pipeline_info.stage.pName = "main";
+    pipeline_info.layout = layout;
+
+    auto res = device.createComputePipeline(nullptr, pipeline_info);
+    if (res.result != vk::Result::eSuccess)
+    {
+        std::cerr << "failed to create particle simulation pipeline: " << vk::to_string(res.result) << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    return res.value;
+}
+
+vk::PipelineLayout create_particle_draw_layout(vk::Device device)
+{
+    vk::PushConstantRange push_constant_range{};
+    push_constant_range.stageFlags = vk::ShaderStageFlagBits::eVertex;
+    push_constant_range.offset = 0;
+    push_constant_range.size = sizeof(ParticleDrawParams);
+
+    vk::PipelineLayoutCreateInfo pipeline_layout_info{};
+    pipeline_layout_info.setPushConstantRanges(push_constant_range);
+
+    auto res = device.createPipelineLayout(pipeline_layout_info);
+    if (res.result != vk::Result::eSuccess)
+    {
+        std::cerr << "failed to create particle draw pipeline layout" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    return res.value;
+}
+
+vk::Pipeline create_particle_draw_pipeline(vk::Device device, vk::RenderPass render_pass, vk::PipelineLayout layout,
+                                           vk::ShaderModule vert_module, vk::ShaderModule frag_module)
+{
+    vk::PipelineShaderStageCreateInfo shader_stages[2]{};
+    shader_stages[0].stage = vk::ShaderStageFlagBits::eVertex;
+    shader_stages[0].module = vert_module;
+    shader_stages[0].pName = "main";
+    shader_stages[1].stage = vk::ShaderStageFlagBits::eFragment;
+    shader_stages[1].module = frag_module;
+    shader_stages[1].pName = "main";
+
+    vk::DynamicState dynamic_states[] = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+    vk::PipelineDynamicStateCreateInfo dynamic_state{};
+    dynamic_state.setDynamicStates(dynamic_states);
+
+    vk::VertexInputBindingDescription binding_description{};
+    binding_description.binding = 0;
+    binding_description.stride = sizeof(Particle);
+    binding_description.inputRate = vk::VertexInputRate::eVertex;
+
+    vk::VertexInputAttributeDescription attribute_descriptions[2]{};
+    attribute_descriptions[0].binding = 0;
+    attribute_descriptions[0].location = 0;
+    attribute_descriptions[0].format = vk::Format::eR32G32B32A32Sfloat;
+    attribute_descriptions[0].offset = offsetof(Particle, position);
+
+    attribute_descriptions[1].binding = 0;
+    attribute_descriptions[1].location = 1;
+    attribute_descriptions[1].format = vk::Format::eR32G32B32A32Sfloat;
+    attribute_descriptions[1].offset = offsetof(Particle, velocity);
+
+    vk::PipelineVertexInputStateCreateInfo vertex_input_info{};
+    vertex_input_info.setVertexBindingDescriptions(binding_description);
+    vertex_input_info.setVertexAttributeDescriptions(attribute_descriptions);
+
+    vk::PipelineInputAssemblyStateCreateInfo input_assembly{};
+    input_assembly.topology = vk::PrimitiveTopology::ePointList;
+    input_assembly.primitiveRestartEnable = VK_FALSE;
+
+    vk::PipelineViewportStateCreateInfo viewport_state{};
+    viewport_state.viewportCount = 1;
+    viewport_state.scissorCount = 1;
+
+    vk::PipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.polygonMode = vk::PolygonMode::eFill;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = vk::CullModeFlagBits::eNone;
+
+    vk::PipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.rasterizationSamples = vk::SampleCountFlagBits::e1;
+    multisampling.minSampleShading = 1.0f;
+
+    // dense regions glow, and the result does not depend on the order of the points
+    vk::PipelineColorBlendAttachmentState color_blend_attachment{};
+    color_blend_attachment.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+                                            vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+    color_blend_attachment.blendEnable = VK_TRUE;
+    color_blend_attachment.srcColorBlendFactor = vk::BlendFactor::eOne;
+    color_blend_attachment.dstColorBlendFactor = vk::BlendFactor::eOne;
+    color_blend_attachment.colorBlendOp = vk::BlendOp::eAdd;
+    color_blend_attachment.srcAlphaBlendFactor = vk::BlendFactor::eZero;
+    color_blend_attachment.dstAlphaBlendFactor = vk::BlendFactor::eOne;
+    color_blend_attachment.alphaBlendOp = vk::BlendOp::eAdd;
+
+    vk::PipelineColorBlendStateCreateInfo color_blending{};
+    color_blending.logicOpEnable = VK_FALSE;
+    color_blending.setAttachments(color_blend_attachment);
+
+    // points behind a mesh are hidden, they never hide each other
+    vk::PipelineDepthStencilStateCreateInfo depth_stencil{};
+    depth_stencil.depthTestEnable = VK_TRUE;
+    depth_stencil.depthWriteEnable = VK_FALSE;
+    depth_stencil.depthCompareOp = vk::CompareOp::eLess;
+
+    vk::GraphicsPipelineCreateInfo pipeline_info{};
+    pipeline_info.setStages(shader_stages);
+    pipeline_info.pVertexInputState = &vertex_input_info;
+    pipeline_info.pInputAssemblyState = &input_assembly;
+    pipeline_info.pViewportState = &viewport_state;
+    pipeline_info.pRasterizationState = &rasterizer;
+    pipeline_info.pMultisampleState = &multisampling;
+    pipeline_info.pDepthStencilState = &depth_stencil;
+    pipeline_info.pColorBlendState = &color_blending;
+    pipeline_info.pDynamicState = &dynamic_state;
+    pipeline_info.layout = layout;
+    pipeline_info.renderPass = render_pass;
+    pipeline_info.subpass = 0;
+
+    auto res = device.createGraphicsPipeline(nullptr, pipeline_info);
+    if (res.result != vk::Result::eSuccess)
+    {
+        std::cerr << "failed to create particle draw pipeline: " << vk::to_string(res.result) << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    return res.value;
+}
+
+void PipelineManager::init(vk::Device device, vk::RenderPass render_pass, vk::PipelineLayout layout,
+                           const std::string &cache_path, uint32_t thread_count)
+{
+    this->device = device;
+    this->render_pass = render_pass;
+    this->layout = layout;
+    this->cache_path = cache_path;
+
+    // the driver validates the header and ignores data from another device or driver version
+    std::vector<uint8_t> cache_data;
+    std::ifstream f(cache_path, std::ios::binary);
+    if (f.is_open())
+    {
+        cache_data.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+    }
+
+    vk::PipelineCacheCreateInfo cache_info{};
+    cache_info.initialDataSize = cache_data.size();
+    cache_info.pInitialData = cache_data.data();
+
+    auto res = device.createPipelineCache(cache_info);
+    if (res.result != vk::Result::eSuccess)
+    {
+        std::cerr << "failed to create pipeline cache" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    cache = res.value;
+
+    std::cerr << "pipeline cache: " << cache_data.size() << " bytes loaded from " << cache_path << std::endl;
+
+    compile_pool.start(thread_count);
+}
+
+vk::Pipeline PipelineManager::compile(const ShaderProgram &program, const PipelineKey &key)
+{
+    uint64_t hash = hash_pipeline(program, key);
+
+    auto it = entries.find(hash);
+    if (it != entries.end())
+    {
+        // already queued or compiled in the background, wait for it rather than compiling twice
+        compile_pool.wait_idle();
+        return vk::Pipeline(it->second->pipeline.load(std::memory_order_acquire));
+    }
+
+    vk::Pipeline pipeline = create_pipeline_variant(device, cache, render_pass, layout, program, key);
+
+    auto entry = std::make_unique<Entry>();
+    entry->pipeline.store(static_cast<VkPipeline>(pipeline), std::memory_order_relaxed);
+    entries.emplace(hash, std::move(entry));
+
+    return pipeline;
+}
+
+vk::Pipeline PipelineManager::get(const ShaderProgram &program, const PipelineKey &key, vk::Pipeline fallback)
+{
+    uint64_t hash = hash_pipeline(program, key);
+
+    auto it = entries.find(hash);
+    if (it != entries.end())
+    {
+        VkPipeline pipeline = it->second->pipeline.load(std::memory_order_acquire);
+        return pipeline != VK_NULL_HANDLE ? vk::Pipeline(pipeline) : fallback;
+    }
+
+    Entry *entry = entries.emplace(hash, std::make_unique<Entry>()).first->second.get();
+
+    // program and key are copied, the program's modules live until destroy()
+    ShaderProgram program_copy = program;
+    compile_pool.submit([this, entry, program_copy, key] {
+        vk::Pipeline pipeline = create_pipeline_variant(device, cache, render_pass, layout, program_copy, key);
+        entry->pipeline.store(static_cast<VkPipeline>(pipeline), std::memory_order_release);
+    });
+
+    return fallback;
+}
+
+void PipelineManager::destroy()
+{
+    compile_pool.stop();
+
+    auto res = device.getPipelineCacheData(cache);
+    if (res.result == vk::Result::eSuccess)
+    {
+        std::ofstream f(cache_path, std::ios::binary);
+        f.write((const char *)res.value.data(), (std::streamsize)res.value.size());
+    }
+
+    for (auto &entry : entries)
+    {
+        VkPipeline pipeline = entry.second->pipeline.load(std::memory_order_relaxed);
+        if (pipeline != VK_NULL_HANDLE)
+        {
+            device.destroyPipeline(vk::Pipeline(pipeline));
+        }
+    }
+    entries.clear();
+
+    device.destroyPipelineCache(cache);
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "thread_pool.h"
+#include "vulkan_config.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// values for the constant_id specialization constants declared in tri.frag
+struct FragmentSpecialization
+{
+    uint32_t use_texture = 1;
+    uint32_t desaturate = 0;
+};
+
+// std140 block at set 1, binding 0 of tri.vert, one per draw, read through a dynamic offset into the uniform ring
+struct DrawUniforms
+{
+    float model_view_projection[16]; // column major
+    float time;                      // seconds of simulated time
+    float padding[3];
+};
+
+// push constant block of tri.frag
+struct DrawPushConstants
+{
+    float tint[4];
+};
+
+struct ShaderProgram
+{
+    vk::ShaderModule vert_module;
+    vk::ShaderModule frag_module;
+    uint64_t hash; // of both SPIR-V blobs
+};
+
+// the fixed function state and specialization that may differ between pipelines, everything else is shared
+struct PipelineKey
+{
+    vk::CullModeFlags cull_mode = vk::CullModeFlagBits::eBack;
+    vk::FrontFace front_face = vk::FrontFace::eClockwise;
+    vk::PolygonMode polygon_mode = vk::PolygonMode::eFill;
+    bool blend_enable = false;
+    FragmentSpecialization frag_specialization;
+};
+
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+
+uint64_t hash_bytes(const void *data, size_t size, uint64_t seed = FNV_OFFSET_BASIS);
+
+uint64_t hash_pipeline(const ShaderProgram &program, const PipelineKey &key);
+
+// every pipeline is built for a render pass with a color attachment and a depth attachment in this format, the first
+// of D32, D32S8 and D24S8 the device supports, eUndefined if none
+vk::Format find_depth_format(vk::PhysicalDevice physical_device);
+
+// set 0 holds the material, the same for every pipeline variant
+vk::DescriptorSetLayout create_descriptor_set_layout(vk::Device device);
+
+// set 1, a single dynamic uniform buffer holding DrawUniforms
+vk::DescriptorSetLayout create_uniform_set_layout(vk::Device device);
+
+// both sets and a DrawPushConstants range
+vk::PipelineLayout create_pipeline_layout(vk::Device device, vk::DescriptorSetLayout set_layout,
+                                          vk::DescriptorSetLayout uniform_set_layout);
+
+// depth tested against smaller is nearer, blended variants test without writing. Returns a null handle on failure
+vk::Pipeline create_pipeline_variant(vk::Device device, vk::PipelineCache cache, vk::RenderPass render_pass,
+                                     vk::PipelineLayout layout, const ShaderProgram &program, const PipelineKey &key);
+
+// particles.comp, binding 0 is the source state and binding 1 the destination, ParticleSimParams push constants
+vk::DescriptorSetLayout create_particle_set_layout(vk::Device device);
+vk::PipelineLayout create_particle_sim_layout(vk::Device device, vk::DescriptorSetLayout set_layout);
+vk::Pipeline create_particle_sim_pipeline(vk::Device device, vk::PipelineLayout layout, vk::ShaderModule module);
+
+// points read straight from a particle buffer bound as vertex buffer 0, additive and depth tested without writing,
+// ParticleDrawParams push constants
+vk::PipelineLayout create_particle_draw_layout(vk::Device device);
+vk::Pipeline create_particle_draw_pipeline(vk::Device device, vk::RenderPass render_pass, vk::PipelineLayout layout,
+                                           vk::ShaderModule vert_module, vk::ShaderModule frag_module);
+
+// pipelines keyed by hash_pipeline(), missing ones are compiled on a thread pool against a shared pipeline cache
+class PipelineManager
+{
+  public:
+    void init(vk::Device device, vk::RenderPass render_pass, vk::PipelineLayout layout, const std::string &cache_path,
+              uint32_t thread_count);
+
+    // compiles on the calling thread, for pipelines that have to exist before the first frame
+    vk::Pipeline compile(const ShaderProgram &program, const PipelineKey &key);
+
+    // render thread only, never blocks: returns fallback and queues a compile until the variant is ready
+    vk::Pipeline get(const ShaderProgram &program, const PipelineKey &key, vk::Pipeline fallback);
+
+    // waits for background compiles, writes the pipeline cache back and destroys every pipeline
+    void destroy();
+
+  private:
+    struct Entry
+    {
+        std::atomic<VkPipeline> pipeline{VK_NULL_HANDLE};
+    };
+
+    vk::Device device;
+    vk::RenderPass render_pass;
+    vk::PipelineLayout layout;
+    vk::PipelineCache cache;
+    std::string cache_path;
+
+    ThreadPool compile_pool;
+    std::unordered_map<uint64_t, std::unique_ptr<Entry>> entries;
+};
@@ -0,0 +1,82 @@
+#include "resolution_scale.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+// going up has to leave this much of the budget unused
+const float INCREASE_HEADROOM = 0.85f;
+
+} // namespace
+
+void ResolutionScaler::init(const ResolutionScaleConfig &config)
+{
+    this->config = config;
+    this->config.min_scale = std::max(config.min_scale, config.step);
+    this->config.max_scale = std::max(config.max_scale, this->config.min_scale);
+    this->config.sample_count = std::max(config.sample_count, 1u);
+
+    // start sharp, the first window of samples tells whether that is affordable
+    current = this->config.max_scale;
+    samples.assign(this->config.sample_count, 0.0f);
+    next_sample = 0;
+    sample_total = 0;
+}
+
+float ResolutionScaler::average_ms() const
+{
+    if (sample_total == 0)
+    {
+        return 0.0f;
+    }
+
+    float sum = 0.0f;
+    for (uint32_t i = 0; i < sample_total; i++)
+    {
+        sum += samples[i];
+    }
+    return sum / (float)sample_total;
+}
+
+bool ResolutionScaler::add_sample(float gpu_ms)
+{
+    samples[next_sample] = gpu_ms;
+    next_sample = (next_sample + 1) % config.sample_count;
+    sample_total = std::min(sample_total + 1, config.sample_count);
+
+    if (sample_total < config.sample_count)
+    {
+        return false;
+    }
+
+    float average = average_ms();
+    float next = current;
+
+    if (average > config.gpu_budget_ms)
+    {
+        next = std::max(current - config.step, config.min_scale);
+    }
+    else if (current < config.max_scale)
+    {
+        // GPU time is roughly proportional to the pixel count
+        float up = std::min(current + config.step, config.max_scale);
+        float ratio = (up * up) / (current * current);
+        if (average * ratio < config.gpu_budget_ms * INCREASE_HEADROOM)
+        {
+            next = up;
+        }
+    }
+
+    if (std::fabs(next - current) < 1e-6f)
+    {
+        return false;
+    }
+
+    // samples taken at the old scale say nothing about the new one
+    current = next;
+    next_sample = 0;
+    sample_total = 0;
+    return true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct ResolutionScaleConfig
+{
+    float min_scale = 0.5f;
+    float max_scale = 1.0f;
+    float step = 0.125f;
+    float gpu_budget_ms = 12.0f;
+    uint32_t sample_count = 16; // rolling window, also the number of frames to wait after a change
+};
+
+// Picks a render scale in fixed steps from rolling GPU frame times. Goes down a step as soon as the average
+// is over budget, and only up again when the average scaled by the pixel count of the next step still fits
+// with some headroom, so it does not oscillate between two steps.
+class ResolutionScaler
+{
+  public:
+    void init(const ResolutionScaleConfig &config);
+
+    // returns true if the scale changed
+    bool add_sample(float gpu_ms);
+
+    float scale() const
+    {
+        return current;
+    }
+
+    float average_ms() const;
+
+  private:
+    ResolutionScaleConfig config;
+    float current = 1.0f;
+
+    std::vector<float> samples; // ring buffer
+    uint32_t next_sample = 0;
+    uint32_t sample_total = 0; // samples since the last change, saturates at sample_count
+};
@@ -0,0 +1,124 @@
+#include "simulation.h"
+
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+
+// fall this many ticks behind and the simulation skips ahead instead of catching up
+const uint32_t SIM_MAX_CATCH_UP_TICKS = 5;
+
+} // namespace
+
+void Simulation::init(const float mesh_center[3], float mesh_radius, uint32_t extra_instances, float extent)
+{
+    instances.clear();
+    instances.add(mesh_center, mesh_radius);
+
+    // the mesh stays where it is
+    origin_x.assign(1, mesh_center[0]);
+    origin_y.assign(1, mesh_center[1]);
+    origin_z.assign(1, mesh_center[2]);
+    orbit_radius.assign(1, 0.0f);
+    orbit_speed.assign(1, 0.0f);
+    orbit_phase.assign(1, 0.0f);
+
+    // fixed seed so runs are comparable
+    uint32_t state = 1;
+    auto next = [&] {
+        state = state * 1664525u + 1013904223u;
+        return (float)(state >> 8) / (float)(1u << 24);
+    };
+
+    for (uint32_t i = 0; i < extra_instances; i++)
+    {
+        float center[3] = {(next() * 2.0f - 1.0f) * extent, (next() * 2.0f - 1.0f) * extent,
+                           (next() * 2.0f - 1.0f) * extent};
+        instances.add(center, mesh_radius * (0.05f + next() * 0.2f));
+
+        origin_x.push_back(center[0]);
+        origin_y.push_back(center[1]);
+        origin_z.push_back(center[2]);
+        orbit_radius.push_back(next() * extent * 0.25f);
+        orbit_speed.push_back(0.5f + next() * 2.0f);
+        orbit_phase.push_back(next() * 6.2831853f);
+    }
+
+    tick_count = 0;
+    time = 0.0;
+}
+
+void Simulation::start(double tick_hz, RenderMetrics *metrics)
+{
+    this->metrics = metrics;
+    tick_seconds = 1.0 / tick_hz;
+
+    publish();
+    snapshots.acquire();
+
+    stopping.store(false);
+    thread = std::thread(&Simulation::run, this);
+}
+
+void Simulation::stop()
+{
+    stopping.store(true);
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+}
+
+void Simulation::run()
+{
+    using clock = std::chrono::steady_clock;
+    const auto tick_duration = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(tick_seconds));
+
+    auto next_tick = clock::now() + tick_duration;
+    while (!stopping.load(std::memory_order_relaxed))
+    {
+        std::this_thread::sleep_until(next_tick);
+
+        auto tick_start = clock::now();
+        if (tick_start - next_tick > tick_duration * SIM_MAX_CATCH_UP_TICKS)
+        {
+            // simulated time keeps its fixed step, the wall clock is what gets dropped
+            next_tick = tick_start;
+        }
+        next_tick += tick_duration;
+
+        tick(tick_seconds);
+        publish();
+
+        metrics->sim_ticks.add();
+        metrics->sim_tick_us.observe(
+            (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - tick_start).count());
+    }
+}
+
+void Simulation::tick(double dt)
+{
+    tick_count++;
+    time += dt;
+
+    const float t = (float)time;
+    const size_t count = instances.size();
+    for (size_t i = 1; i < count; i++)
+    {
+        float angle = orbit_phase[i] + orbit_speed[i] * t;
+        float center[3] = {origin_x[i] + orbit_radius[i] * std::cos(angle),
+                           origin_y[i] + orbit_radius[i] * std::sin(angle), origin_z[i]};
+        instances.set_bounds((uint32_t)i, center, instances.radius_data()[i]);
+    }
+}
+
+void Simulation::publish()
+{
+    // the slot keeps the capacity of the snapshot it held before, so this does not allocate after warm up
+    FrameSnapshot &snapshot = snapshots.back();
+    snapshot.tick = tick_count;
+    snapshot.time = time;
+    snapshot.instances = instances;
+    snapshots.publish();
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "instance_store.h"
+#include "metrics.h"
+#include "triple_buffer.h"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// the mesh is always the first instance
+const uint32_t SIM_MESH_INSTANCE = 0;
+
+// everything the render thread needs from one simulation tick, read only once published
+struct FrameSnapshot
+{
+    uint64_t tick = 0;
+    double time = 0.0; // seconds of simulated time
+    InstanceStore instances;
+};
+
+// Advances the scene at a fixed tick rate on its own thread and hands the result to the render thread through
+// a triple buffer, so a slow tick never stalls a frame and a slow frame never stalls the simulation.
+class Simulation
+{
+  public:
+    // extra instances are random spheres of the given extent orbiting their start position
+    void init(const float mesh_center[3], float mesh_radius, uint32_t extra_instances, float extent);
+
+    // publishes the first snapshot before returning, so there is always one to render
+    void start(double tick_hz, RenderMetrics *metrics);
+    void stop();
+
+    // render thread only, returns false if no tick was published since the last call
+    bool acquire_snapshot()
+    {
+        return snapshots.acquire();
+    }
+
+    // render thread only, valid until the next acquire_snapshot()
+    const FrameSnapshot &snapshot() const
+    {
+        return snapshots.front();
+    }
+
+    size_t instance_count() const
+    {
+        return instances.size();
+    }
+
+  private:
+    void run();
+    void tick(double dt);
+    void publish();
+
+    TripleBuffer<FrameSnapshot> snapshots;
+    std::thread thread;
+    std::atomic<bool> stopping{false};
+    double tick_seconds = 0.0;
+    RenderMetrics *metrics = nullptr;
+
+    // owned by the simulation thread once started
+    uint64_t tick_count = 0;
+    double time = 0.0;
+    InstanceStore instances;
+    std::vector<float> origin_x;
+    std::vector<float> origin_y;
+    std::vector<float> origin_z;
+    std::vector<float> orbit_radius;
+    std::vector<float> orbit_speed; // radians per second
+    std::vector<float> orbit_phase;
+};
@@ -0,0 +1,73 @@
+#include "staging_ring.h"
+
+void StagingRing::init(size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    size = capacity;
+    allocated = 0;
+    released = 0;
+    stopped = false;
+}
+
+bool StagingRing::allocate(size_t alloc_size, size_t alignment, Allocation &allocation)
+{
+    if (alloc_size > size)
+    {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    size_t padding = 0;
+    auto fits = [&] {
+        if (stopped)
+        {
+            return true;
+        }
+
+        if (allocated == released)
+        {
+            // empty, restart at offset 0 so a large allocation never waits on its own padding
+            allocated = released = (allocated + size - 1) / size * size;
+        }
+
+        size_t head = (size_t)(allocated % size);
+        padding = (alignment - head % alignment) % alignment;
+        if (head + padding + alloc_size > size)
+        {
+            // does not fit before the end, skip the tail and wrap around to offset 0
+            padding = size - head;
+        }
+
+        return size - (allocated - released) >= padding + alloc_size;
+    };
+
+    released_cv.wait(lock, fits);
+    if (stopped)
+    {
+        return false;
+    }
+
+    allocation.offset = (size_t)((allocated + padding) % size);
+    allocated += padding + alloc_size;
+    allocation.end = allocated;
+    return true;
+}
+
+void StagingRing::release(uint64_t end)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        released = end;
+    }
+    released_cv.notify_all();
+}
+
+void StagingRing::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+    }
+    released_cv.notify_all();
+}
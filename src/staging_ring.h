@@ -0,0 +1,43 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+// FIFO sub-allocator for a fixed size staging buffer, allocations must be released in the order they were made.
+// Offsets only, the buffer itself is owned by the caller.
+class StagingRing
+{
+  public:
+    struct Allocation
+    {
+        size_t offset;
+        uint64_t end; // pass to release() once the GPU is done reading
+    };
+
+    void init(size_t capacity);
+
+    // blocks until enough space has been released, fails if size exceeds the capacity or on shutdown
+    bool allocate(size_t size, size_t alignment, Allocation &allocation);
+
+    // releases every allocation up to and including the one that returned end
+    void release(uint64_t end);
+
+    // wakes up and fails any blocked allocate()
+    void shutdown();
+
+    size_t capacity() const
+    {
+        return size;
+    }
+
+  private:
+    std::mutex mutex;
+    std::condition_variable released_cv;
+
+    size_t size = 0;
+    uint64_t allocated = 0; // monotonic byte counters, the difference is the space in use
+    uint64_t released = 0;
+    bool stopped = false;
+};
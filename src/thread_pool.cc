@@ -0,0 +1,68 @@
+#include "thread_pool.h"
+
+void ThreadPool::start(uint32_t thread_count)
+{
+    stopping = false;
+    for (uint32_t i = 0; i < thread_count; i++)
+    {
+        workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+void ThreadPool::submit(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    job_cv.notify_one();
+}
+
+void ThreadPool::wait_idle()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    idle_cv.wait(lock, [&] { return jobs.empty() && running == 0; });
+}
+
+void ThreadPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    job_cv.notify_all();
+
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    workers.clear();
+}
+
+void ThreadPool::worker_loop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        job_cv.wait(lock, [&] { return stopping || !jobs.empty(); });
+        if (jobs.empty())
+        {
+            // only reached when stopping, queued jobs are drained first
+            return;
+        }
+
+        std::function<void()> job = std::move(jobs.front());
+        jobs.pop_front();
+        running++;
+
+        lock.unlock();
+        job();
+        lock.lock();
+
+        running--;
+        if (jobs.empty() && running == 0)
+        {
+            idle_cv.notify_all();
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+  public:
+    void start(uint32_t thread_count);
+
+    void submit(std::function<void()> job);
+
+    // blocks until the queue is empty and no job is running
+    void wait_idle();
+
+    // finishes queued jobs and joins the workers
+    void stop();
+
+    uint32_t thread_count() const
+    {
+        return (uint32_t)workers.size();
+    }
+
+  private:
+    void worker_loop();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable job_cv;
+    std::condition_variable idle_cv;
+    uint32_t running = 0;
+    bool stopping = false;
+};
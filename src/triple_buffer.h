@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Single producer, single consumer handoff of the newest value. The producer fills back() and publishes it, the
+// consumer takes the newest published value with acquire(). Both sides are wait-free: they only swap their slot
+// with the shared middle slot, so the producer never waits for the consumer and older values are dropped.
+template <typename T> class TripleBuffer
+{
+  public:
+    // producer only, the slot is reused so its contents are whatever was published two swaps ago
+    T &back()
+    {
+        return slots[back_index];
+    }
+
+    void publish()
+    {
+        uint8_t old = middle.exchange(back_index | FRESH, std::memory_order_acq_rel);
+        back_index = old & INDEX_MASK;
+    }
+
+    // consumer only, returns false and keeps the current front if nothing was published since the last call
+    bool acquire()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH))
+        {
+            return false;
+        }
+
+        uint8_t old = middle.exchange(front_index, std::memory_order_acq_rel);
+        front_index = old & INDEX_MASK;
+        return true;
+    }
+
+    // consumer only, valid until the next acquire()
+    const T &front() const
+    {
+        return slots[front_index];
+    }
+
+  private:
+    static const uint8_t INDEX_MASK = 0x3;
+    static const uint8_t FRESH = 0x4;
+
+    T slots[3];
+    std::atomic<uint8_t> middle{1};
+    uint8_t back_index = 0;  // producer
+    uint8_t front_index = 2; // consumer
+};
@@ -0,0 +1,53 @@
+#include "uniform_ring.h"
+
+#include <limits>
+
+static size_t align_up(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+bool UniformRing::init(void *mapped, size_t frame_size, uint32_t frame_count, size_t alignment)
+{
+    if (required_size(frame_size, frame_count, alignment) == 0)
+    {
+        return false;
+    }
+
+    data = (uint8_t *)mapped;
+    align = alignment;
+    region_size = align_up(frame_size, alignment);
+    frames = frame_count;
+    frame_begin = 0;
+    head = 0;
+    return true;
+}
+
+size_t UniformRing::required_size(size_t frame_size, uint32_t frame_count, size_t alignment)
+{
+    const size_t max_size = std::numeric_limits<uint32_t>::max();
+    if (frame_count == 0 || frame_size > max_size || align_up(frame_size, alignment) > max_size / frame_count)
+    {
+        return 0;
+    }
+    return align_up(frame_size, alignment) * frame_count;
+}
+
+void UniformRing::begin_frame(uint32_t frame)
+{
+    frame_begin = region_size * (frame % frames);
+    head = frame_begin;
+}
+
+void *UniformRing::allocate(size_t size, uint32_t &offset)
+{
+    size_t begin = align_up(head, align);
+    if (begin + size > frame_begin + region_size)
+    {
+        return nullptr;
+    }
+
+    head = begin + size;
+    offset = (uint32_t)begin;
+    return data + begin;
+}
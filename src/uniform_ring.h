@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Linear sub-allocator over a persistently mapped uniform buffer, split into one region per frame in flight.
+// Allocations of a frame stay valid until begin_frame() comes back to its region, the caller waits for the frame
+// that last used the region before that. Offsets only, the buffer itself is owned by the caller.
+class UniformRing
+{
+  public:
+    // alignment is minUniformBufferOffsetAlignment, a power of two, frame_size is rounded up to it. Returns false
+    // if the ring would not fit in the 32 bit dynamic offsets it hands out.
+    bool init(void *mapped, size_t frame_size, uint32_t frame_count, size_t alignment);
+
+    // bytes the buffer needs for init() with the same arguments, 0 if that is more than a dynamic offset can address
+    static size_t required_size(size_t frame_size, uint32_t frame_count, size_t alignment);
+
+    // starts allocating from the beginning of the frame's region
+    void begin_frame(uint32_t frame);
+
+    // returns nullptr if the region is full, offset is from the start of the buffer and usable as a dynamic offset
+    void *allocate(size_t size, uint32_t &offset);
+
+    // the allocation at a dynamic offset returned by allocate()
+    const void *at(uint32_t offset) const
+    {
+        return data + offset;
+    }
+
+    // bytes allocated since begin_frame(), padding included
+    size_t frame_used() const
+    {
+        return head - frame_begin;
+    }
+
+  private:
+    uint8_t *data = nullptr;
+    size_t region_size = 0;
+    uint32_t frames = 1;
+    size_t align = 1;
+    size_t frame_begin = 0;
+    size_t head = 0;
+};
@@ -0,0 +1,8 @@
+#pragma once
+
+// every translation unit has to see the same vulkan.hpp configuration
+#define VULKAN_HPP_NO_EXCEPTIONS
+#define VULKAN_HPP_NO_SMART_HANDLE
+#define VULKAN_HPP_ASSERT_ON_RESULT
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_handles.hpp>
@@ -0,0 +1,140 @@
+// measures the frustum culling kernels on a random scene, single threaded and split over worker threads
+//
+//     cull_bench [instance count] [--iterations <n>] [--threads <n>]
+
+#include "frustum_cull.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// column-major, right handed view space looking down -z, Vulkan depth range
+static void perspective(float fov_y, float aspect, float near, float far, float m[16])
+{
+    float f = 1.0f / std::tan(fov_y / 2.0f);
+    memset(m, 0, sizeof(float) * 16);
+    m[0] = f / aspect;
+    m[5] = -f;
+    m[10] = far / (near - far);
+    m[11] = -1.0f;
+    m[14] = near * far / (near - far);
+}
+
+static void fill_scene(InstanceStore &store, size_t count)
+{
+    // fixed seed, every run and kernel sees the same scene
+    uint32_t state = 12345;
+    auto next = [&] {
+        state = state * 1664525u + 1013904223u;
+        return (float)(state >> 8) / (float)(1u << 24);
+    };
+
+    store.clear();
+    for (size_t i = 0; i < count; i++)
+    {
+        float center[3] = {next() * 200.0f - 100.0f, next() * 200.0f - 100.0f, next() * 200.0f - 100.0f};
+        store.add(center, 0.1f + next() * 2.0f);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t instance_count = 1000000;
+    uint32_t iterations = 100;
+    uint32_t thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+        {
+            iterations = (uint32_t)std::max(atoi(argv[++i]), 1);
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            thread_count = (uint32_t)std::max(atoi(argv[++i]), 1);
+        }
+        else
+        {
+            instance_count = (size_t)std::max(atoll(argv[i]), 1ll);
+        }
+    }
+
+    InstanceStore store;
+    fill_scene(store, instance_count);
+
+    float view_projection[16];
+    perspective(1.0f, 16.0f / 9.0f, 0.1f, 150.0f, view_projection);
+    Frustum frustum = frustum_from_matrix(view_projection);
+
+    std::vector<uint32_t> reference(instance_count);
+    reference.resize(cull_spheres(CullKernel::Scalar, frustum, store, 0, instance_count, reference.data()));
+
+    std::cout << instance_count << " instances, " << reference.size() << " visible, " << iterations
+              << " iterations" << std::endl;
+    std::cout << "kernel  threads      Mobj/s  Mobj/s/core" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+
+    auto report = [&](CullKernel kernel, uint32_t threads, double seconds) {
+        double objects_per_second = (double)instance_count * iterations / seconds;
+        std::cout << std::left << std::setw(8) << cull_kernel_name(kernel) << std::right << std::setw(7) << threads
+                  << std::setw(12) << objects_per_second / 1e6 << std::setw(13)
+                  << objects_per_second / 1e6 / threads << std::endl;
+    };
+
+    bool mismatch = false;
+    std::vector<uint32_t> visible;
+
+    for (CullKernel kernel : {CullKernel::Scalar, CullKernel::Sse, CullKernel::Avx2, CullKernel::Neon})
+    {
+        if (!cull_kernel_supported(kernel))
+        {
+            continue;
+        }
+
+        visible.resize(instance_count);
+        auto start = std::chrono::steady_clock::now();
+        size_t count = 0;
+        for (uint32_t i = 0; i < iterations; i++)
+        {
+            count = cull_spheres(kernel, frustum, store, 0, instance_count, visible.data());
+        }
+        report(kernel, 1, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+        visible.resize(count);
+        if (visible != reference)
+        {
+            std::cerr << cull_kernel_name(kernel) << ": result differs from the scalar kernel" << std::endl;
+            mismatch = true;
+        }
+
+        if (thread_count > 1)
+        {
+            FrustumCuller culler;
+            culler.init(thread_count, kernel);
+
+            start = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < iterations; i++)
+            {
+                culler.cull(frustum, store, visible);
+            }
+            report(kernel, thread_count,
+                   std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            culler.destroy();
+
+            if (visible != reference)
+            {
+                std::cerr << cull_kernel_name(kernel) << ": threaded result differs from the scalar kernel"
+                          << std::endl;
+                mismatch = true;
+            }
+        }
+    }
+
+    return mismatch ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,90 @@
+// polls the metrics socket of a running learn-vulkan and prints what it serves
+//
+//     metrics_client [socket path] [--interval <ms>]
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static bool fetch(const std::string &socket_path, std::string &text)
+{
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path))
+    {
+        std::cerr << "socket path too long: " << socket_path << std::endl;
+        return false;
+    }
+    strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        std::cerr << "failed to create socket" << std::endl;
+        return false;
+    }
+
+    if (connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        std::cerr << "failed to connect to " << socket_path << ": " << strerror(errno) << std::endl;
+        close(fd);
+        return false;
+    }
+
+    // the server writes everything and closes the connection
+    text.clear();
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0)
+    {
+        text.append(buffer, (size_t)n);
+    }
+    close(fd);
+
+    return n == 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *env_path = getenv("LEARN_VULKAN_METRICS_SOCKET");
+    std::string socket_path = env_path != nullptr ? env_path : "/tmp/learn-vulkan.sock";
+    int interval_ms = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc)
+        {
+            interval_ms = atoi(argv[++i]);
+        }
+        else
+        {
+            socket_path = argv[i];
+        }
+    }
+
+    std::string text;
+    do
+    {
+        if (!fetch(socket_path, text))
+        {
+            return EXIT_FAILURE;
+        }
+        std::cout << text << std::flush;
+
+        if (interval_ms > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+            std::cout << std::endl;
+        }
+    } while (interval_ms > 0);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,960 @@
+// replays a capture recorded with LEARN_VULKAN_CAPTURE without a window, as fast as the device allows, and reports
+// CPU and GPU time per captured frame
+//
+//     replay <capture file> [--loops <n>]
+//
+// textures are not part of captures, sampled images are bound to a 1x1 white texture
+
+#include "capture.h"
+#include "pipelines.h"
+#include "uniform_ring.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+class Replayer
+{
+  public:
+    void run(const CaptureFile &capture, uint32_t loops)
+    {
+        init_vulkan(capture);
+        create_resources(capture);
+        replay(capture, loops);
+        cleanup();
+    }
+
+  private:
+    vk::Instance instance;
+    vk::PhysicalDevice physical_device;
+    vk::Device device;
+    vk::PhysicalDeviceFeatures enabled_features;
+    uint32_t queue_family = 0;
+    vk::Queue queue;
+
+    bool timestamps_supported = false;
+    float timestamp_period = 1.0f;
+    vk::QueryPool query_pool;
+
+    vk::Extent2D target_extent;
+    vk::Image target_image;
+    vk::DeviceMemory target_memory;
+    vk::ImageView target_view;
+    vk::Image depth_image;
+    vk::DeviceMemory depth_memory;
+    vk::ImageView depth_view;
+    vk::RenderPass render_pass;
+    vk::Framebuffer framebuffer;
+
+    vk::DescriptorSetLayout descriptor_set_layout;
+    vk::DescriptorSetLayout uniform_set_layout;
+    vk::PipelineLayout pipeline_layout;
+    ShaderProgram shader_program{};
+    std::vector<vk::Pipeline> pipelines; // indexed by capture id
+
+    std::vector<vk::Buffer> buffers; // indexed by capture id
+    std::vector<vk::DeviceMemory> buffer_memories;
+
+    vk::Image white_image;
+    vk::DeviceMemory white_memory;
+    vk::ImageView white_view;
+    vk::Sampler sampler;
+    vk::DescriptorPool descriptor_pool;
+    vk::DescriptorSet descriptor_set;
+
+    // captured uniform blocks are copied in as they are bound, laid out for this device's offset alignment
+    UniformRing uniform_ring;
+    vk::Buffer uniform_buffer;
+    vk::DeviceMemory uniform_memory;
+    vk::DescriptorSet uniform_set;
+
+    vk::CommandPool command_pool;
+    vk::CommandBuffer command_buffer;
+    vk::Fence fence;
+
+    static bool has_extension(const std::vector<vk::ExtensionProperties> &extensions, const char *name)
+    {
+        for (const auto &extension : extensions)
+        {
+            if (strcmp(extension.extensionName, name) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void init_vulkan(const CaptureFile &capture)
+    {
+        vk::ApplicationInfo app_info{};
+        app_info.pApplicationName = "Learn Vulkan Replay";
+        app_info.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+        app_info.pEngineName = "No Engine";
+        app_info.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+        app_info.apiVersion = VK_API_VERSION_1_0;
+
+        // headless, no surface extensions needed
+        std::vector<const char *> instance_extensions;
+        vk::InstanceCreateInfo instance_info{};
+        instance_info.pApplicationInfo = &app_info;
+
+        auto supported = vk::enumerateInstanceExtensionProperties();
+        if (supported.result == vk::Result::eSuccess &&
+            has_extension(supported.value, VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME))
+        {
+            instance_extensions.push_back(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
+            instance_info.setFlags(vk::InstanceCreateFlagBits::eEnumeratePortabilityKHR);
+        }
+        instance_info.setPEnabledExtensionNames(instance_extensions);
+
+        auto instance_res = vk::createInstance(instance_info);
+        if (instance_res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to create Vulkan instance: " << vk::to_string(instance_res.result) << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        instance = instance_res.value;
+
+        auto devices = instance.enumeratePhysicalDevices();
+        if (devices.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to enumerate physical devices" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        bool found = false;
+        for (const auto &candidate : devices.value)
+        {
+            auto families = candidate.getQueueFamilyProperties();
+            for (uint32_t i = 0; i < families.size(); i++)
+            {
+                if (families[i].queueFlags & vk::QueueFlagBits::eGraphics)
+                {
+                    physical_device = candidate;
+                    queue_family = i;
+                    timestamps_supported = families[i].timestampValidBits > 0;
+                    found = true;
+                    break;
+                }
+            }
+            if (found)
+            {
+                break;
+            }
+        }
+
+        if (!found)
+        {
+            std::cerr << "failed to find a GPU with a graphics queue" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        vk::PhysicalDeviceProperties properties = physical_device.getProperties();
+        timestamp_period = properties.limits.timestampPeriod;
+        std::cerr << "replaying on " << properties.deviceName << std::endl;
+
+        vk::DeviceQueueCreateInfo queue_create_info{};
+        queue_create_info.queueFamilyIndex = queue_family;
+        queue_create_info.queueCount = 1;
+        float queue_priority = 1.0f;
+        queue_create_info.pQueuePriorities = &queue_priority;
+
+        // the same optional features the app enables, so every captured pipeline can be rebuilt
+        vk::PhysicalDeviceFeatures supported_features = physical_device.getFeatures();
+        vk::PhysicalDeviceFeatures device_features{};
+        device_features.fillModeNonSolid = supported_features.fillModeNonSolid;
+        enabled_features = device_features;
+
+        std::vector<const char *> device_extensions;
+        auto device_supported = physical_device.enumerateDeviceExtensionProperties();
+        if (device_supported.result == vk::Result::eSuccess &&
+            has_extension(device_supported.value, "VK_KHR_portability_subset"))
+        {
+            device_extensions.push_back("VK_KHR_portability_subset");
+        }
+
+        vk::DeviceCreateInfo device_info{};
+        device_info.setQueueCreateInfos(queue_create_info);
+        device_info.pEnabledFeatures = &device_features;
+        device_info.setPEnabledExtensionNames(device_extensions);
+
+        auto device_res = physical_device.createDevice(device_info);
+        if (device_res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to create logical device" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        device = device_res.value;
+        queue = device.getQueue(queue_family, 0);
+
+        vk::CommandPoolCreateInfo pool_info{};
+        pool_info.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+        pool_info.queueFamilyIndex = queue_family;
+        auto pool_res = device.createCommandPool(pool_info);
+        if (pool_res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to create command pool" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        command_pool = pool_res.value;
+
+        vk::CommandBufferAllocateInfo alloc_info{};
+        alloc_info.commandPool = command_pool;
+        alloc_info.level = vk::CommandBufferLevel::ePrimary;
+        alloc_info.commandBufferCount = 1;
+        auto cb_res = device.allocateCommandBuffers(alloc_info);
+        if (cb_res.result != vk::Result::eSuccess || cb_res.value.size() != 1)
+        {
+            std::cerr << "failed to allocate command buffers" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        command_buffer = cb_res.value[0];
+
+        auto fence_res = device.createFence({});
+        if (fence_res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to create fence" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        fence = fence_res.value;
+
+        if (timestamps_supported)
+        {
+            vk::QueryPoolCreateInfo query_info{};
+            query_info.queryType = vk::QueryType::eTimestamp;
+            query_info.queryCount = 2;
+            auto query_res = device.createQueryPool(query_info);
+            if (query_res.result != vk::Result::eSuccess)
+            {
+                std::cerr << "failed to create query pool" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            query_pool = query_res.value;
+        }
+        else
+        {
+            std::cerr << "timestamps not supported, GPU times will be missing" << std::endl;
+        }
+
+        target_extent = vk::Extent2D{capture.target.width, capture.target.height};
+    }
+
+    uint32_t find_memory_type(uint32_t type_filter, vk::MemoryPropertyFlags properties)
+    {
+        vk::PhysicalDeviceMemoryProperties mem_properties = physical_device.getMemoryProperties();
+        for (uint32_t i = 0; i < mem_properties.memoryTypeCount; i++)
+        {
+            if ((type_filter & (1 << i)) && (mem_properties.memoryTypes[i].propertyFlags & properties) == properties)
+            {
+                return i;
+            }
+        }
+
+        std::cerr << "failed to find suitable memory type" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    vk::DeviceMemory allocate(vk::MemoryRequirements requirements, vk::MemoryPropertyFlags properties)
+    {
+        vk::MemoryAllocateInfo alloc_info{};
+        alloc_info.allocationSize = requirements.size;
+        alloc_info.memoryTypeIndex = find_memory_type(requirements.memoryTypeBits, properties);
+
+        auto res = device.allocateMemory(alloc_info);
+        if (res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to allocate device memory" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        return res.value;
+    }
+
+    void create_buffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties,
+                       vk::Buffer &buffer, vk::DeviceMemory &memory)
+    {
+        vk::BufferCreateInfo buffer_info{};
+        buffer_info.size = std::max<vk::DeviceSize>(size, 4);
+        buffer_info.usage = usage;
+        buffer_info.sharingMode = vk::SharingMode::eExclusive;
+
+        auto res = device.createBuffer(buffer_info);
+        if (res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to create buffer" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        buffer = res.value;
+
+        memory = allocate(device.getBufferMemoryRequirements(buffer), properties);
+        if (device.bindBufferMemory(buffer, memory, 0) != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to bind buffer memory" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    void create_image(vk::Extent2D extent, vk::Format format, vk::ImageUsageFlags usage, vk::Image &image,
+                      vk::DeviceMemory &memory, vk::ImageView &view,
+                      vk::ImageAspectFlags aspect = vk::ImageAspectFlagBits::eColor)
+    {
+        vk::ImageCreateInfo image_info{};
+        image_info.imageType = vk::ImageType::e2D;
+        image_info.extent = vk::Extent3D{extent.width, extent.height, 1};
+        image_info.mipLevels = 1;
+        image_info.arrayLayers = 1;
+        image_info.format = format;
+        image_info.tiling = vk::ImageTiling::eOptimal;
+        image_info.initialLayout = vk::ImageLayout::eUndefined;
+        image_info.usage = usage;
+        image_info.samples = vk::SampleCountFlagBits::e1;
+        image_info.sharingMode = vk::SharingMode::eExclusive;
+
+        auto image_res = device.createImage(image_info);
+        if (image_res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to create image" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        image = image_res.value;
+
+        memory = allocate(device.getImageMemoryRequirements(image), vk::MemoryPropertyFlagBits::eDeviceLocal);
+        if (device.bindImageMemory(image, memory, 0) != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to bind image memory" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        vk::ImageViewCreateInfo view_info{};
+        view_info.image = image;
+        view_info.viewType = vk::ImageViewType::e2D;
+        view_info.format = format;
+        view_info.subresourceRange.aspectMask = aspect;
+        view_info.subresourceRange.levelCount = 1;
+        view_info.subresourceRange.layerCount = 1;
+
+        auto view_res = device.createImageView(view_info);
+        if (view_res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to create image view" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        view = view_res.value;
+    }
+
+    void submit_and_wait()
+    {
+        vk::SubmitInfo submit_info{};
+        submit_info.setCommandBuffers(command_buffer);
+
+        if (queue.submit(submit_info, fence) != vk::Result::eSuccess ||
+            device.waitForFences(fence, VK_TRUE, std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to submit command buffer" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        device.resetFences(fence);
+    }
+
+    void create_resources(const CaptureFile &capture)
+    {
+        vk::Format format = (vk::Format)capture.target.format;
+
+        // read_capture() only checks what does not depend on the device
+        vk::PhysicalDeviceLimits limits = physical_device.getProperties().limits;
+        vk::FormatProperties format_properties = physical_device.getFormatProperties(format);
+        if (!(format_properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eColorAttachment) ||
+            target_extent.width > limits.maxImageDimension2D || target_extent.height > limits.maxImageDimension2D)
+        {
+            std::cerr << "capture target " << vk::to_string(format) << " " << target_extent.width << "x"
+                      << target_extent.height << " cannot be rendered on this device" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        create_image(target_extent, format, vk::ImageUsageFlagBits::eColorAttachment, target_image, target_memory,
+                     target_view);
+
+        vk::Format depth_format = find_depth_format(physical_device);
+        if (depth_format == vk::Format::eUndefined)
+        {
+            std::cerr << "failed to find a depth format" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        create_image(target_extent, depth_format, vk::ImageUsageFlagBits::eDepthStencilAttachment, depth_image,
+                     depth_memory, depth_view, vk::ImageAspectFlagBits::eDepth);
+
+        // only formats and sample counts have to match for the pipelines to be compatible
+        vk::AttachmentDescription attachments[2]{};
+        vk::AttachmentDescription &color_attachment = attachments[0];
+        color_attachment.format = format;
+        color_attachment.samples = vk::SampleCountFlagBits::e1;
+        color_attachment.loadOp = vk::AttachmentLoadOp::eClear;
+        color_attachment.storeOp = vk::AttachmentStoreOp::eStore;
+        color_attachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
+        color_attachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+        color_attachment.initialLayout = vk::ImageLayout::eUndefined;
+        color_attachment.finalLayout = vk::ImageLayout::eColorAttachmentOptimal;
+
+        vk::AttachmentDescription &depth_attachment = attachments[1];
+        depth_attachment.format = depth_format;
+        depth_attachment.samples = vk::SampleCountFlagBits::e1;
+        depth_attachment.loadOp = vk::AttachmentLoadOp::eClear;
+        depth_attachment.storeOp = vk::AttachmentStoreOp::eDontCare;
+        depth_attachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
+        depth_attachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+        depth_attachment.initialLayout = vk::ImageLayout::eUndefined;
+        depth_attachment.finalLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+
+        vk::AttachmentReference color_attachment_ref{};
+        color_attachment_ref.attachment = 0;
+        color_attachment_ref.layout = vk::ImageLayout::eColorAttachmentOptimal;
+
+        vk::AttachmentReference depth_attachment_ref{};
+        depth_attachment_ref.attachment = 1;
+        depth_attachment_ref.layout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+
+        vk::SubpassDescription subpass{};
+        subpass.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
+        subpass.setColorAttachments(color_attachment_ref);
+        subpass.pDepthStencilAttachment = &depth_attachment_ref;
+
+        vk::SubpassDependency dependency{};
+        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependency.dstSubpass = 0;
+        dependency.srcStageMask =
+            vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eLateFragmentTests;
+        dependency.srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+        dependency.dstStageMask =
+            vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests;
+        dependency.dstAccessMask =
+            vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+
+        vk::RenderPassCreateInfo render_pass_info{};
+        render_pass_info.setAttachments(attachments);
+        render_pass_info.setSubpasses(subpass);
+        render_pass_info.setDependencies(dependency);
+
+        auto render_pass_res = device.createRenderPass(render_pass_info);
+        if (render_pass_res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to create render pass" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        render_pass = render_pass_res.value;
+
+        vk::FramebufferCreateInfo fb_info{};
+        fb_info.renderPass = render_pass;
+        const vk::ImageView fb_attachments[2] = {target_view, depth_view};
+        fb_info.setAttachments(fb_attachments);
+        fb_info.width = target_extent.width;
+        fb_info.height = target_extent.height;
+        fb_info.layers = 1;
+
+        auto fb_res = device.createFramebuffer(fb_info);
+        if (fb_res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to create framebuffer" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        framebuffer = fb_res.value;
+
+        create_pipelines(capture);
+        create_buffers(capture);
+        create_uniform_ring(capture);
+        create_descriptor_set();
+    }
+
+    vk::ShaderModule create_shader_module(const std::vector<uint8_t> &code)
+    {
+        vk::ShaderModuleCreateInfo create_info{};
+        create_info.codeSize = code.size();
+        create_info.pCode = reinterpret_cast<const uint32_t *>(code.data());
+
+        auto res = device.createShaderModule(create_info);
+        if (res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to create shader module" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        return res.value;
+    }
+
+    void create_pipelines(const CaptureFile &capture)
+    {
+        descriptor_set_layout = create_descriptor_set_layout(device);
+        uniform_set_layout = create_uniform_set_layout(device);
+        pipeline_layout = create_pipeline_layout(device, descriptor_set_layout, uniform_set_layout);
+
+        shader_program.vert_module = create_shader_module(capture.vert_code);
+        shader_program.frag_module = create_shader_module(capture.frag_code);
+
+        // read_capture() guarantees ids are dense, each one is its index
+        for (const auto &captured : capture.pipelines)
+        {
+            if (captured.polygon_mode != VK_POLYGON_MODE_FILL && !enabled_features.fillModeNonSolid)
+            {
+                std::cerr << "capture uses a wireframe pipeline, the device does not support fillModeNonSolid"
+                          << std::endl;
+                exit(EXIT_FAILURE);
+            }
+
+            vk::Pipeline pipeline = create_pipeline_variant(device, nullptr, render_pass, pipeline_layout,
+                                                            shader_program, capture_pipeline_key(captured));
+            if (!pipeline)
+            {
+                exit(EXIT_FAILURE);
+            }
+            pipelines.push_back(pipeline);
+        }
+    }
+
+    void create_buffers(const CaptureFile &capture)
+    {
+        buffers.resize(capture.buffers.size());
+        buffer_memories.resize(capture.buffers.size());
+        for (const auto &captured : capture.buffers)
+        {
+            // a buffer the app never registered, read_capture() rejects every bind of it
+            vk::DeviceSize size = captured.data.size();
+            if (size == 0)
+            {
+                continue;
+            }
+
+            create_buffer(size,
+                          vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer |
+                              vk::BufferUsageFlagBits::eTransferDst,
+                          vk::MemoryPropertyFlagBits::eDeviceLocal, buffers[captured.id],
+                          buffer_memories[captured.id]);
+
+            vk::Buffer staging_buffer;
+            vk::DeviceMemory staging_memory;
+            create_buffer(size, vk::BufferUsageFlagBits::eTransferSrc,
+                          vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                          staging_buffer, staging_memory);
+
+            auto map_res = device.mapMemory(staging_memory, 0, size);
+            if (map_res.result != vk::Result::eSuccess)
+            {
+                std::cerr << "failed to map staging buffer memory" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            memcpy(map_res.value, captured.data.data(), (size_t)size);
+            device.unmapMemory(staging_memory);
+
+            command_buffer.begin(vk::CommandBufferBeginInfo{vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+            vk::BufferCopy region{};
+            region.size = size;
+            command_buffer.copyBuffer(staging_buffer, buffers[captured.id], region);
+            command_buffer.end();
+            submit_and_wait();
+
+            device.destroyBuffer(staging_buffer);
+            device.freeMemory(staging_memory);
+        }
+    }
+
+    void create_uniform_ring(const CaptureFile &capture)
+    {
+        // every BindUniforms op takes its op byte and payload, the largest frame bounds the blocks one frame binds
+        size_t max_blocks = 1;
+        for (const auto &frame : capture.frames)
+        {
+            max_blocks = std::max(max_blocks, frame.size() / (1 + sizeof(CaptureUniforms)));
+        }
+
+        size_t alignment = (size_t)physical_device.getProperties().limits.minUniformBufferOffsetAlignment;
+        size_t frame_size = max_blocks * ((sizeof(DrawUniforms) + alignment - 1) / alignment * alignment);
+        size_t size = UniformRing::required_size(frame_size, 1, alignment);
+        if (size == 0)
+        {
+            std::cerr << "uniform ring does not fit 32-bit offsets" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        create_buffer(size, vk::BufferUsageFlagBits::eUniformBuffer,
+                      vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                      uniform_buffer, uniform_memory);
+
+        auto map_res = device.mapMemory(uniform_memory, 0, size);
+        if (map_res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to map uniform buffer memory" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        if (!uniform_ring.init(map_res.value, frame_size, 1, alignment))
+        {
+            std::cerr << "failed to initialize uniform ring" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    void create_descriptor_set()
+    {
+        vk::Format format = vk::Format::eR8G8B8A8Unorm;
+        create_image(vk::Extent2D{1, 1}, format,
+                     vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst, white_image,
+                     white_memory, white_view);
+
+        // a clear is enough to fill a 1x1 texture
+        vk::ImageSubresourceRange range{};
+        range.aspectMask = vk::ImageAspectFlagBits::eColor;
+        range.levelCount = 1;
+        range.layerCount = 1;
+
+        vk::ImageMemoryBarrier to_transfer{};
+        to_transfer.oldLayout = vk::ImageLayout::eUndefined;
+        to_transfer.newLayout = vk::ImageLayout::eTransferDstOptimal;
+        to_transfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        to_transfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        to_transfer.image = white_image;
+        to_transfer.subresourceRange = range;
+        to_transfer.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+
+        vk::ImageMemoryBarrier to_shader = to_transfer;
+        to_shader.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+        to_shader.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+        to_shader.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        to_shader.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+        command_buffer.begin(vk::CommandBufferBeginInfo{vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
+                                       vk::DependencyFlags(), nullptr, nullptr, to_transfer);
+        command_buffer.clearColorImage(white_image, vk::ImageLayout::eTransferDstOptimal,
+                                       vk::ClearColorValue(1.0f, 1.0f, 1.0f, 1.0f), range);
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                       vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlags(), nullptr,
+                                       nullptr, to_shader);
+        command_buffer.end();
+        submit_and_wait();
+
+        vk::SamplerCreateInfo sampler_info{};
+        sampler_info.magFilter = vk::Filter::eLinear;
+        sampler_info.minFilter = vk::Filter::eLinear;
+        sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+        auto sampler_res = device.createSampler(sampler_info);
+        if (sampler_res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to create sampler" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        sampler = sampler_res.value;
+
+        vk::DescriptorPoolSize pool_sizes[2]{};
+        pool_sizes[0].type = vk::DescriptorType::eCombinedImageSampler;
+        pool_sizes[0].descriptorCount = 1;
+        pool_sizes[1].type = vk::DescriptorType::eUniformBufferDynamic;
+        pool_sizes[1].descriptorCount = 1;
+
+        vk::DescriptorPoolCreateInfo pool_info{};
+        pool_info.setPoolSizes(pool_sizes);
+        pool_info.maxSets = 2;
+        auto pool_res = device.createDescriptorPool(pool_info);
+        if (pool_res.result != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to create descriptor pool" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        descriptor_pool = pool_res.value;
+
+        vk::DescriptorSetLayout set_layouts[2] = {descriptor_set_layout, uniform_set_layout};
+        vk::DescriptorSetAllocateInfo alloc_info{};
+        alloc_info.descriptorPool = descriptor_pool;
+        alloc_info.setSetLayouts(set_layouts);
+        auto set_res = device.allocateDescriptorSets(alloc_info);
+        if (set_res.result != vk::Result::eSuccess || set_res.value.size() != 2)
+        {
+            std::cerr << "failed to allocate descriptor sets" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        descriptor_set = set_res.value[0];
+        uniform_set = set_res.value[1];
+
+        vk::DescriptorImageInfo image_info{};
+        image_info.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+        image_info.imageView = white_view;
+        image_info.sampler = sampler;
+
+        vk::WriteDescriptorSet write{};
+        write.dstSet = descriptor_set;
+        write.dstBinding = 0;
+        write.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+        write.setImageInfo(image_info);
+
+        vk::DescriptorBufferInfo buffer_info{};
+        buffer_info.buffer = uniform_buffer;
+        buffer_info.range = sizeof(DrawUniforms);
+
+        vk::WriteDescriptorSet uniform_write{};
+        uniform_write.dstSet = uniform_set;
+        uniform_write.dstBinding = 0;
+        uniform_write.descriptorType = vk::DescriptorType::eUniformBufferDynamic;
+        uniform_write.setBufferInfo(buffer_info);
+
+        device.updateDescriptorSets({write, uniform_write}, nullptr);
+    }
+
+    void record_frame(const std::vector<uint8_t> &ops)
+    {
+        CaptureCursor cursor(ops);
+        uniform_ring.begin_frame(0);
+        while (!cursor.done())
+        {
+            switch (cursor.next_op())
+            {
+            case CaptureOp::BeginRenderPass: {
+                auto op = cursor.read<CaptureRenderPass>();
+                vk::RenderPassBeginInfo render_pass_info{};
+                render_pass_info.renderPass = render_pass;
+                render_pass_info.framebuffer = framebuffer;
+                render_pass_info.renderArea.extent = vk::Extent2D{std::min(op.width, target_extent.width),
+                                                                  std::min(op.height, target_extent.height)};
+                vk::ClearValue clear_values[2];
+                clear_values[0].color = vk::ClearColorValue(op.clear_color[0], op.clear_color[1], op.clear_color[2],
+                                                            op.clear_color[3]);
+                clear_values[1].depthStencil = vk::ClearDepthStencilValue(1.0f, 0);
+                render_pass_info.setClearValues(clear_values);
+                command_buffer.beginRenderPass(render_pass_info, vk::SubpassContents::eInline);
+                break;
+            }
+            case CaptureOp::EndRenderPass:
+                command_buffer.endRenderPass();
+                break;
+            case CaptureOp::BindPipeline:
+                command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelines[cursor.read<uint32_t>()]);
+                break;
+            case CaptureOp::SetViewport: {
+                auto op = cursor.read<CaptureViewport>();
+                command_buffer.setViewport(
+                    0, vk::Viewport{op.x, op.y, op.width, op.height, op.min_depth, op.max_depth});
+                break;
+            }
+            case CaptureOp::SetScissor: {
+                auto op = cursor.read<CaptureScissor>();
+                command_buffer.setScissor(0, vk::Rect2D{{op.x, op.y}, {op.width, op.height}});
+                break;
+            }
+            case CaptureOp::BindVertexBuffer: {
+                auto op = cursor.read<CaptureBindBuffer>();
+                vk::DeviceSize offset = op.offset;
+                command_buffer.bindVertexBuffers(0, buffers[op.id], offset);
+                break;
+            }
+            case CaptureOp::BindIndexBuffer: {
+                auto op = cursor.read<CaptureBindBuffer>();
+                command_buffer.bindIndexBuffer(buffers[op.id], op.offset, (vk::IndexType)op.index_type);
+                break;
+            }
+            case CaptureOp::BindDescriptorSet:
+                command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout, 0,
+                                                  descriptor_set, nullptr);
+                break;
+            case CaptureOp::BindUniforms: {
+                auto op = cursor.read<CaptureUniforms>();
+                uint32_t offset = 0;
+                void *block = uniform_ring.allocate(sizeof(DrawUniforms), offset);
+                memcpy(block, &op.block, sizeof(DrawUniforms));
+                command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout, 1, uniform_set,
+                                                  offset);
+                break;
+            }
+            case CaptureOp::PushConstants: {
+                auto op = cursor.read<DrawPushConstants>();
+                command_buffer.pushConstants(pipeline_layout, vk::ShaderStageFlagBits::eFragment, 0, sizeof(op),
+                                             &op);
+                break;
+            }
+            case CaptureOp::Draw: {
+                auto op = cursor.read<CaptureDraw>();
+                command_buffer.draw(op.vertex_count, op.instance_count, op.first_vertex, op.first_instance);
+                break;
+            }
+            case CaptureOp::DrawIndexed: {
+                auto op = cursor.read<CaptureDrawIndexed>();
+                command_buffer.drawIndexed(op.index_count, op.instance_count, op.first_index, op.vertex_offset,
+                                           op.first_instance);
+                break;
+            }
+            default:
+                // read_capture() only lets command ops into frames
+                std::cerr << "unexpected op in frame" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    void replay(const CaptureFile &capture, uint32_t loops)
+    {
+        const size_t frame_count = capture.frames.size();
+        std::vector<double> cpu_ms(frame_count, 0.0);
+        std::vector<double> gpu_ms(frame_count, 0.0);
+
+        auto replay_start = std::chrono::steady_clock::now();
+
+        for (uint32_t loop = 0; loop < loops; loop++)
+        {
+            for (size_t i = 0; i < frame_count; i++)
+            {
+                auto cpu_start = std::chrono::steady_clock::now();
+
+                command_buffer.reset(vk::CommandBufferResetFlags());
+                command_buffer.begin(vk::CommandBufferBeginInfo{vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+                if (timestamps_supported)
+                {
+                    command_buffer.resetQueryPool(query_pool, 0, 2);
+                    command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, query_pool, 0);
+                }
+
+                record_frame(capture.frames[i]);
+
+                if (timestamps_supported)
+                {
+                    command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, query_pool, 1);
+                }
+                if (command_buffer.end() != vk::Result::eSuccess)
+                {
+                    std::cerr << "failed to record command buffer" << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+
+                submit_and_wait();
+
+                auto cpu_end = std::chrono::steady_clock::now();
+                cpu_ms[i] += std::chrono::duration<double, std::milli>(cpu_end - cpu_start).count();
+
+                if (timestamps_supported)
+                {
+                    uint64_t timestamps[2];
+                    auto res = device.getQueryPoolResults(query_pool, 0, 2, sizeof(timestamps), timestamps,
+                                                          sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+                    if (res == vk::Result::eSuccess)
+                    {
+                        gpu_ms[i] += double(timestamps[1] - timestamps[0]) * timestamp_period / 1e6;
+                    }
+                }
+            }
+        }
+
+        double total_s =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - replay_start).count();
+
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << "frame    cpu ms    gpu ms" << std::endl;
+
+        double cpu_sum = 0.0, gpu_sum = 0.0;
+        double cpu_max = 0.0, gpu_max = 0.0;
+        for (size_t i = 0; i < frame_count; i++)
+        {
+            double cpu = cpu_ms[i] / loops;
+            double gpu = gpu_ms[i] / loops;
+            std::cout << std::setw(5) << i << std::setw(10) << cpu << std::setw(10) << gpu << std::endl;
+
+            cpu_sum += cpu;
+            gpu_sum += gpu;
+            cpu_max = std::max(cpu_max, cpu);
+            gpu_max = std::max(gpu_max, gpu);
+        }
+
+        if (frame_count > 0)
+        {
+            std::cout << "mean " << std::setw(10) << cpu_sum / frame_count << std::setw(10) << gpu_sum / frame_count
+                      << std::endl;
+            std::cout << "max  " << std::setw(10) << cpu_max << std::setw(10) << gpu_max << std::endl;
+            std::cout << frame_count * loops << " frames in " << total_s << " s, "
+                      << double(frame_count * loops) / total_s << " fps" << std::endl;
+        }
+    }
+
+    void cleanup()
+    {
+        if (device.waitIdle() != vk::Result::eSuccess)
+        {
+            std::cerr << "failed to wait for device idle" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        for (size_t i = 0; i < buffers.size(); i++)
+        {
+            device.destroyBuffer(buffers[i]);
+            device.freeMemory(buffer_memories[i]);
+        }
+
+        for (auto pipeline : pipelines)
+        {
+            device.destroyPipeline(pipeline);
+        }
+        device.destroyShaderModule(shader_program.vert_module);
+        device.destroyShaderModule(shader_program.frag_module);
+        device.destroyPipelineLayout(pipeline_layout);
+        device.destroyDescriptorSetLayout(uniform_set_layout);
+        device.destroyDescriptorSetLayout(descriptor_set_layout);
+        device.destroyBuffer(uniform_buffer);
+        device.freeMemory(uniform_memory);
+
+        device.destroyDescriptorPool(descriptor_pool);
+        device.destroySampler(sampler);
+        device.destroyImageView(white_view);
+        device.destroyImage(white_image);
+        device.freeMemory(white_memory);
+
+        device.destroyFramebuffer(framebuffer);
+        device.destroyRenderPass(render_pass);
+        device.destroyImageView(depth_view);
+        device.destroyImage(depth_image);
+        device.freeMemory(depth_memory);
+        device.destroyImageView(target_view);
+        device.destroyImage(target_image);
+        device.freeMemory(target_memory);
+
+        device.destroyQueryPool(query_pool);
+        device.destroyFence(fence);
+        device.destroyCommandPool(command_pool);
+        device.destroy();
+        instance.destroy();
+    }
+};
+
+int main(int argc, char **argv)
+{
+    const char *path = nullptr;
+    uint32_t loops = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--loops") == 0 && i + 1 < argc)
+        {
+            loops = std::max(atoi(argv[++i]), 1);
+        }
+        else
+        {
+            path = argv[i];
+        }
+    }
+
+    if (path == nullptr)
+    {
+        std::cerr << "usage: replay <capture file> [--loops <n>]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    CaptureFile capture;
+    std::string error;
+    if (!read_capture(path, capture, error))
+    {
+        std::cerr << "failed to read capture " << path << ": " << error << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cerr << "capture: " << capture.frames.size() << " frames, " << capture.pipelines.size() << " pipelines, "
+              << capture.buffers.size() << " buffers, " << capture.target.width << "x" << capture.target.height
+              << std::endl;
+
+    Replayer replayer;
+    replayer.run(capture, loops);
+
+    return EXIT_SUCCESS;
+}